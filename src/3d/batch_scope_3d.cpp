@@ -0,0 +1,38 @@
+#include "batch_scope_3d.h"
+
+#include "utils/utils.h"
+
+GODOT_WARNING_DISABLE()
+#include <godot_cpp/classes/os.hpp>
+GODOT_WARNING_RESTORE()
+
+void DebugDraw3DBatchScope::_bind_methods() {
+#define REG_CLASS_NAME DebugDraw3DBatchScope
+	REG_METHOD(_manual_end);
+#undef REG_CLASS_NAME
+}
+
+void DebugDraw3DBatchScope::_manual_end() {
+	if (end_action) {
+		if (OS::get_singleton()->get_thread_caller_id() != thread_id) {
+			PRINT_ERROR(NAMEOF(DebugDraw3DBatchScope) " must be deleted in the thread where it was created. The batch will remain open.");
+		} else {
+			end_action();
+		}
+	}
+	end_action = nullptr;
+}
+
+DebugDraw3DBatchScope::DebugDraw3DBatchScope() {
+	thread_id = 0;
+	end_action = nullptr;
+}
+
+DebugDraw3DBatchScope::DebugDraw3DBatchScope(const uint64_t &p_thread_id, const end_func p_end) {
+	thread_id = p_thread_id;
+	end_action = p_end;
+}
+
+DebugDraw3DBatchScope::~DebugDraw3DBatchScope() {
+	_manual_end();
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "utils/compiler.h"
+
+#include <functional>
+
+GODOT_WARNING_DISABLE()
+#include <godot_cpp/classes/ref_counted.hpp>
+GODOT_WARNING_RESTORE()
+using namespace godot;
+
+/**
+ * @brief
+ * This class is used to group many `draw_*` calls of DebugDraw3D into one batch.
+ *
+ * Inside the batch, the process type is resolved only once,
+ * so loops of scalar calls like DebugDraw3D.draw_line or DebugDraw3D.draw_box_xf become cheaper.
+ * The batch ends when this object is deleted.
+ *
+ * To create it, use DebugDraw3D.new_batch_scope.
+ *
+ * @warning
+ * As with DebugDraw3DScopeConfig, do not save this object outside the method, and do not use it between `await`s.
+ * It must be deleted in the same thread in which it was created.
+ *
+ * ### Examples:
+ * ```python
+ * var _b = DebugDraw3D.new_batch_scope()
+ * for a in agents:
+ * 	DebugDraw3D.draw_box_xf(a.global_transform, Color.YELLOW)
+ * ```
+ *
+ * ```cs
+ * using (var b = DebugDraw3D.NewBatchScope())
+ *     foreach (var a in agents)
+ *         DebugDraw3D.DrawBoxXf(a.GlobalTransform, Colors.Yellow);
+ * ```
+ */
+class DebugDraw3DBatchScope : public RefCounted {
+	GDCLASS(DebugDraw3DBatchScope, RefCounted)
+
+protected:
+	/// @private
+	static void _bind_methods();
+
+private:
+	uint64_t thread_id;
+
+	typedef std::function<void()> end_func;
+	end_func end_action;
+
+public:
+	/// @private
+	// It can be used for example in C#
+	void _manual_end();
+
+	/// @private
+	DebugDraw3DBatchScope();
+
+	/// @private
+	DebugDraw3DBatchScope(const uint64_t &p_thread_id, const end_func p_end);
+	~DebugDraw3DBatchScope();
+};
@@ -6,6 +6,10 @@
 void DebugDraw3DConfig::_bind_methods() {
 #define REG_CLASS_NAME DebugDraw3DConfig
 
+	BIND_ENUM_CONSTANT(EVICTION_OLDEST_FIRST);
+	BIND_ENUM_CONSTANT(EVICTION_NEAREST_TO_EXPIRY);
+	BIND_ENUM_CONSTANT(EVICTION_REJECT_NEW);
+
 #pragma region Parameters
 
 	REG_PROP_BOOL(freeze_3d_render);
@@ -13,6 +17,16 @@ void DebugDraw3DConfig::_bind_methods() {
 	REG_PROP_BOOL(use_frustum_culling);
 	REG_PROP(frustum_length_scale, Variant::FLOAT);
 	REG_PROP_BOOL(force_use_camera_from_scene);
+	REG_PROP_BOOL(use_instanced_lines);
+	REG_PROP(culling_min_pixel_radius, Variant::FLOAT);
+	REG_PROP(lod_low_detail_size, Variant::FLOAT);
+	REG_PROP(lod_high_detail_size, Variant::FLOAT);
+	REG_PROP(max_instances_per_type, Variant::INT);
+	REG_PROP(max_lines, Variant::INT);
+	REG_PROP(max_memory_bytes, Variant::INT);
+	REG_PROP(eviction_policy, Variant::INT);
+	REG_PROP_BOOL(use_deduplication);
+	REG_PROP(unused_meshes_release_time, Variant::FLOAT);
 	REG_PROP(geometry_render_layers, Variant::INT);
 	REG_PROP(line_hit_color, Variant::COLOR);
 	REG_PROP(line_after_hit_color, Variant::COLOR);
@@ -61,6 +75,86 @@ bool DebugDraw3DConfig::is_force_use_camera_from_scene() const {
 	return force_use_camera_from_scene;
 }
 
+void DebugDraw3DConfig::set_use_instanced_lines(const bool &_state) {
+	use_instanced_lines = _state;
+}
+
+bool DebugDraw3DConfig::is_use_instanced_lines() const {
+	return use_instanced_lines;
+}
+
+void DebugDraw3DConfig::set_culling_min_pixel_radius(const real_t &_radius) {
+	culling_min_pixel_radius = Math::max(_radius, (real_t)0);
+}
+
+real_t DebugDraw3DConfig::get_culling_min_pixel_radius() const {
+	return culling_min_pixel_radius;
+}
+
+void DebugDraw3DConfig::set_lod_low_detail_size(const real_t &_size) {
+	lod_low_detail_size = Math::max(_size, (real_t)0);
+}
+
+real_t DebugDraw3DConfig::get_lod_low_detail_size() const {
+	return lod_low_detail_size;
+}
+
+void DebugDraw3DConfig::set_lod_high_detail_size(const real_t &_size) {
+	lod_high_detail_size = Math::max(_size, (real_t)0);
+}
+
+real_t DebugDraw3DConfig::get_lod_high_detail_size() const {
+	return lod_high_detail_size;
+}
+
+void DebugDraw3DConfig::set_max_instances_per_type(const int64_t &_count) {
+	max_instances_per_type = Math::max(_count, (int64_t)0);
+}
+
+int64_t DebugDraw3DConfig::get_max_instances_per_type() const {
+	return max_instances_per_type;
+}
+
+void DebugDraw3DConfig::set_max_lines(const int64_t &_count) {
+	max_lines = Math::max(_count, (int64_t)0);
+}
+
+int64_t DebugDraw3DConfig::get_max_lines() const {
+	return max_lines;
+}
+
+void DebugDraw3DConfig::set_max_memory_bytes(const int64_t &_bytes) {
+	max_memory_bytes = Math::max(_bytes, (int64_t)0);
+}
+
+int64_t DebugDraw3DConfig::get_max_memory_bytes() const {
+	return max_memory_bytes;
+}
+
+void DebugDraw3DConfig::set_eviction_policy(const EvictionPolicy &_policy) {
+	eviction_policy = _policy;
+}
+
+DebugDraw3DConfig::EvictionPolicy DebugDraw3DConfig::get_eviction_policy() const {
+	return eviction_policy;
+}
+
+void DebugDraw3DConfig::set_use_deduplication(const bool &_state) {
+	use_deduplication = _state;
+}
+
+bool DebugDraw3DConfig::is_use_deduplication() const {
+	return use_deduplication;
+}
+
+void DebugDraw3DConfig::set_unused_meshes_release_time(const real_t &_time) {
+	unused_meshes_release_time = _time;
+}
+
+real_t DebugDraw3DConfig::get_unused_meshes_release_time() const {
+	return unused_meshes_release_time;
+}
+
 void DebugDraw3DConfig::set_geometry_render_layers(const int32_t &_layers) {
 	geometry_render_layers = _layers;
 }
@@ -17,6 +17,19 @@ using namespace godot;
 class DebugDraw3DConfig : public RefCounted {
 	GDCLASS(DebugDraw3DConfig, RefCounted)
 
+public:
+	/**
+	 * What to do with a new object when one of the geometry limits is reached.
+	 */
+	enum EvictionPolicy : int {
+		/// Remove the oldest object with a duration.
+		EVICTION_OLDEST_FIRST = 0,
+		/// Remove the object with a duration that will expire first.
+		EVICTION_NEAREST_TO_EXPIRY = 1,
+		/// Do not add the new object.
+		EVICTION_REJECT_NEW = 2,
+	};
+
 private:
 	int32_t geometry_render_layers = 1;
 	bool freeze_3d_render = false;
@@ -24,6 +37,16 @@ private:
 	bool use_frustum_culling = true;
 	real_t frustum_length_scale = 0;
 	bool force_use_camera_from_scene = false;
+	bool use_instanced_lines = false;
+	real_t lod_low_detail_size = 0;
+	real_t lod_high_detail_size = 0;
+	real_t culling_min_pixel_radius = 0;
+	int64_t max_instances_per_type = 0;
+	int64_t max_lines = 0;
+	int64_t max_memory_bytes = 0;
+	EvictionPolicy eviction_policy = EvictionPolicy::EVICTION_OLDEST_FIRST;
+	bool use_deduplication = false;
+	real_t unused_meshes_release_time = 10;
 	Color line_hit_color = Colors::red;
 	Color line_after_hit_color = Colors::green;
 
@@ -64,6 +87,79 @@ public:
 	void set_force_use_camera_from_scene(const bool &_state);
 	bool is_force_use_camera_from_scene() const;
 
+	/**
+	 * Set whether wireframe lines are drawn as instances of a unit segment mesh instead of a single dynamic mesh.
+	 * Instanced lines are culled one by one and do not rebuild the whole mesh every frame,
+	 * which is usually faster for many static or long-living lines.
+	 */
+	void set_use_instanced_lines(const bool &_state);
+	bool is_use_instanced_lines() const;
+
+	/**
+	 * Set the radius in pixels below which instances and chunks of lines are not drawn.
+	 * The radius is estimated from their bounds. The value `0` disables it.
+	 */
+	void set_culling_min_pixel_radius(const real_t &_radius);
+	real_t get_culling_min_pixel_radius() const;
+
+	/**
+	 * Set the size of spheres and cylinders on the screen relative to the height of the viewport,
+	 * below which their simplified meshes are used. The value `0` disables it.
+	 */
+	void set_lod_low_detail_size(const real_t &_size);
+	real_t get_lod_low_detail_size() const;
+
+	/**
+	 * Set the size of spheres on the screen relative to the height of the viewport,
+	 * above which their HD meshes are used even if DebugDraw3DScopeConfig.set_hd_sphere is not enabled. The value `0` disables it.
+	 */
+	void set_lod_high_detail_size(const real_t &_size);
+	real_t get_lod_high_detail_size() const;
+
+	/**
+	 * Set the maximum number of instances of each type in each Viewport. The value `0` disables the limit.
+	 *
+	 * The number of instances of each type is shown in the profiler in `DebugDraw3DStats`.
+	 */
+	void set_max_instances_per_type(const int64_t &_count);
+	int64_t get_max_instances_per_type() const;
+
+	/**
+	 * Set the maximum number of lines or chunks of lines in each Viewport. The value `0` disables the limit.
+	 */
+	void set_max_lines(const int64_t &_count);
+	int64_t get_max_lines() const;
+
+	/**
+	 * Set the maximum estimated memory in bytes for all the stored geometry. The value `0` disables the limit.
+	 */
+	void set_max_memory_bytes(const int64_t &_bytes);
+	int64_t get_max_memory_bytes() const;
+
+	/**
+	 * Set what happens when a new object exceeds one of the limits.
+	 * Only objects with a duration can be evicted. If there are none, the new object is rejected.
+	 */
+	void set_eviction_policy(const EvictionPolicy &_policy);
+	EvictionPolicy get_eviction_policy() const;
+
+	/**
+	 * Set whether the identical shapes drawn several times in the same frame will be added only once.
+	 * A repeated shape with a longer duration extends the duration of the added one.
+	 *
+	 * Shapes are compared exactly, so shapes that differ only by a rounding error are not merged.
+	 * This adds hashing of every shape, so enable it only if there are many duplicates.
+	 */
+	void set_use_deduplication(const bool &_state);
+	bool is_use_deduplication() const;
+
+	/**
+	 * Set the time in seconds after which the render instances of the shape types that are no longer drawn are released.
+	 * They are created again on the next use. A negative value disables the release.
+	 */
+	void set_unused_meshes_release_time(const real_t &_time);
+	real_t get_unused_meshes_release_time() const;
+
 	/**
 	 * Set the visibility layer on which the 3D geometry will be drawn.
 	 * Similar to using VisualInstance3D.layers.
@@ -83,3 +179,5 @@ public:
 	void set_line_after_hit_color(const Color &_new_color);
 	Color get_line_after_hit_color() const;
 };
+
+VARIANT_ENUM_CAST(DebugDraw3DConfig::EvictionPolicy);
@@ -70,7 +70,7 @@ real_t DebugDraw3DScopeConfig::get_plane_size() const {
 }
 
 Ref<DebugDraw3DScopeConfig> DebugDraw3DScopeConfig::set_viewport(Viewport *_value) const {
-	data->dcd.viewport = _value;
+	data->dcd = DebugContainerDependent(_value, data->dcd.no_depth_test);
 	return Ref<DebugDraw3DScopeConfig>(this);
 }
 
@@ -95,7 +95,7 @@ DebugDraw3DScopeConfig::DebugDraw3DScopeConfig() {
 	data = std::make_shared<Data>();
 }
 
-DebugDraw3DScopeConfig::DebugDraw3DScopeConfig(const uint64_t &p_thread_id, const uint64_t &p_guard_id, const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_parent, const unregister_func p_unreg) {
+DebugDraw3DScopeConfig::DebugDraw3DScopeConfig(const uint64_t &p_thread_id, const uint64_t &p_guard_id, const DebugDraw3DScopeConfig::Data *p_parent, const unregister_func p_unreg) {
 	unregister_action = p_unreg;
 
 	thread_id = p_thread_id;
@@ -116,12 +116,20 @@ DebugDraw3DScopeConfig::Data::Data() {
 	dcd = {};
 }
 
-DebugDraw3DScopeConfig::Data::Data(const std::shared_ptr<Data> &p_parent) {
+DebugDraw3DScopeConfig::Data::Data(const Data *p_parent) {
 	thickness = p_parent->thickness;
 	center_brightness = p_parent->center_brightness;
 	hd_sphere = p_parent->hd_sphere;
 	plane_size = p_parent->plane_size;
 
-	dcd.viewport = p_parent->dcd.viewport;
-	dcd.no_depth_test = p_parent->dcd.no_depth_test;
+	dcd = p_parent->dcd;
+}
+
+bool DebugDraw3DScopeConfig::Data::is_equal(const Data *p_other) const {
+	return thickness == p_other->thickness &&
+		   center_brightness == p_other->center_brightness &&
+		   hd_sphere == p_other->hd_sphere &&
+		   plane_size == p_other->plane_size &&
+		   dcd.viewport_id == p_other->dcd.viewport_id &&
+		   dcd.no_depth_test == p_other->dcd.no_depth_test;
 }
@@ -72,17 +72,20 @@ private:
 public:
 	/// @private
 	struct DebugContainerDependent {
-		// TODO replace by instance_id
+		/// Must not be dereferenced without checking the `viewport_id`. The viewport can be freed before the commands are merged.
 		Viewport *viewport;
+		uint64_t viewport_id;
 		bool no_depth_test;
 
 		DebugContainerDependent() :
 				viewport(nullptr),
+				viewport_id(0),
 				no_depth_test(false) {
 		}
 
 		DebugContainerDependent(Viewport *p_viewport, bool p_no_depth_test) :
 				viewport(p_viewport),
+				viewport_id(p_viewport ? p_viewport->get_instance_id() : 0),
 				no_depth_test(p_no_depth_test) {
 		}
 	};
@@ -97,7 +100,9 @@ public:
 		DebugContainerDependent dcd;
 
 		Data();
-		Data(const std::shared_ptr<Data> &parent);
+		Data(const Data *parent);
+
+		bool is_equal(const Data *p_other) const;
 	};
 	/// @private
 	std::shared_ptr<Data> data = nullptr;
@@ -167,6 +172,6 @@ public:
 
 	// `DDScopedConfig3D` is passed as Ref to avoid a random unreference
 	/// @private
-	DebugDraw3DScopeConfig(const uint64_t &p_thread_id, const uint64_t &p_guard_id, const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_parent, const unregister_func p_unreg);
+	DebugDraw3DScopeConfig(const uint64_t &p_thread_id, const uint64_t &p_guard_id, const DebugDraw3DScopeConfig::Data *p_parent, const unregister_func p_unreg);
 	~DebugDraw3DScopeConfig();
 };
@@ -78,13 +78,16 @@ void DebugDraw3D::_bind_methods() {
 
 	ClassDB::bind_method(D_METHOD(NAMEOF(draw_sphere), "position", "radius", "color", "duration"), &DebugDraw3D::draw_sphere, 0.5f, Colors::empty_color, 0);
 	ClassDB::bind_method(D_METHOD(NAMEOF(draw_sphere_xf), "transform", "color", "duration"), &DebugDraw3D::draw_sphere_xf, Colors::empty_color, 0);
+	ClassDB::bind_method(D_METHOD(NAMEOF(draw_spheres), "positions", "radii", "colors", "color", "duration"), &DebugDraw3D::draw_spheres, PackedColorArray(), Colors::empty_color, 0);
 
 	ClassDB::bind_method(D_METHOD(NAMEOF(draw_cylinder), "transform", "color", "duration"), &DebugDraw3D::draw_cylinder, Colors::empty_color, 0);
 	ClassDB::bind_method(D_METHOD(NAMEOF(draw_cylinder_ab), "a", "b", "radius", "color", "duration"), &DebugDraw3D::draw_cylinder_ab, 0.5f, Colors::empty_color, 0);
+	ClassDB::bind_method(D_METHOD(NAMEOF(draw_cylinders_ab), "points", "radii", "colors", "color", "duration"), &DebugDraw3D::draw_cylinders_ab, PackedColorArray(), Colors::empty_color, 0);
 
 	ClassDB::bind_method(D_METHOD(NAMEOF(draw_box), "position", "rotation", "size", "color", "is_box_centered", "duration"), &DebugDraw3D::draw_box, Colors::empty_color, false, 0);
 	ClassDB::bind_method(D_METHOD(NAMEOF(draw_box_ab), "a", "b", "up", "color", "is_ab_diagonal", "duration"), &DebugDraw3D::draw_box_ab, Vector3(0, 1, 0), Colors::empty_color, true, 0);
 	ClassDB::bind_method(D_METHOD(NAMEOF(draw_box_xf), "transform", "color", "is_box_centered", "duration"), &DebugDraw3D::draw_box_xf, Colors::empty_color, true, 0);
+	ClassDB::bind_method(D_METHOD(NAMEOF(draw_boxes_xf), "transforms", "colors", "color", "is_box_centered", "duration"), &DebugDraw3D::draw_boxes_xf, PackedColorArray(), Colors::empty_color, true, 0);
 	ClassDB::bind_method(D_METHOD(NAMEOF(draw_aabb), "aabb", "color", "duration"), &DebugDraw3D::draw_aabb, Colors::empty_color, 0);
 	ClassDB::bind_method(D_METHOD(NAMEOF(draw_aabb_ab), "a", "b", "color", "duration"), &DebugDraw3D::draw_aabb_ab, Colors::empty_color, 0);
 
@@ -125,9 +128,15 @@ void DebugDraw3D::_bind_methods() {
 	REG_METHOD(get_render_stats_for_world, "viewport");
 	REG_METHOD(new_scoped_config);
 	REG_METHOD(scoped_config);
+	REG_METHOD(begin_batch);
+	REG_METHOD(end_batch);
+	REG_METHOD(new_batch_scope);
 
 #ifndef DISABLE_DEBUG_RENDERING
 	REG_METHOD(_register_viewport_world_deferred);
+#ifdef DEBUG_ENABLED
+	REG_METHOD(_get_segment_transforms, "lines", "radii");
+#endif
 #endif
 
 #undef REG_CLASS_NAME
@@ -188,18 +197,18 @@ void DebugDraw3D::process(double p_delta) {
 #ifndef DISABLE_DEBUG_RENDERING
 	FrameMarkStart("3D Update");
 
+	_flush_draw_commands();
+
 	// Update 3D debug
 	for (const auto &p : debug_containers) {
-		for (const auto &dgc : p.second) {
-			if (dgc) {
-				dgc->update_geometry(p_delta);
-			}
-		}
+		p.second->update_geometry(p_delta);
 	}
 
 	_clear_scoped_configs();
 	// Reset viewport cache after frame
 	viewport_to_world_cache.clear();
+	// Cameras can be moved before the next frame
+	frame_culling_data.clear();
 	FrameMarkEnd("3D Update");
 #endif
 }
@@ -209,12 +218,10 @@ void DebugDraw3D::physics_process_start(double p_delta) {
 #ifndef DISABLE_DEBUG_RENDERING
 	FrameMarkStart("3D Physics Step");
 
+	_flush_draw_commands();
+
 	for (const auto &p : debug_containers) {
-		for (const auto &dgc : p.second) {
-			if (dgc) {
-				dgc->update_geometry_physics_start(p_delta);
-			}
-		}
+		p.second->update_geometry_physics_start(p_delta);
 	}
 #endif
 }
@@ -223,11 +230,7 @@ void DebugDraw3D::physics_process_end(double p_delta) {
 	ZoneScoped;
 #ifndef DISABLE_DEBUG_RENDERING
 	for (const auto &p : debug_containers) {
-		for (const auto &dgc : p.second) {
-			if (dgc) {
-				dgc->update_geometry_physics_end(p_delta);
-			}
-		}
+		p.second->update_geometry_physics_end(p_delta);
 	}
 
 	FrameMarkEnd("3D Physics Step");
@@ -235,76 +238,94 @@ void DebugDraw3D::physics_process_end(double p_delta) {
 }
 
 #ifndef DISABLE_DEBUG_RENDERING
-const std::shared_ptr<DebugDraw3DScopeConfig::Data> DebugDraw3D::scoped_config_for_current_thread() {
-	ZoneScoped;
-	LOCK_GUARD(datalock);
-	uint64_t thread = OS::get_singleton()->get_thread_caller_id();
-
-	const auto &it = cached_scoped_configs.find(thread);
-	if (it != cached_scoped_configs.cend()) {
-		return it->second;
-	}
-
-	const auto &it_v = scoped_configs.find(thread);
-	if (it_v != scoped_configs.cend()) {
-		const auto &cfgs = it_v->second;
-		if (!cfgs.empty()) {
-			DebugDraw3DScopeConfig *tmp = cfgs.back().second;
-			cached_scoped_configs[thread] = tmp->data;
-			return tmp->data;
+DebugDraw3D::ThreadScopedConfigs &DebugDraw3D::_get_thread_scoped_configs() {
+	thread_local ThreadScopedConfigs cfgs;
+
+	uint64_t epoch = scoped_configs_epoch.load(std::memory_order_acquire);
+	if (cfgs.owner_id != get_instance_id() || cfgs.epoch != epoch) {
+		if (cfgs.owner_id != get_instance_id()) {
+			cfgs.thread_id = OS::get_singleton()->get_thread_caller_id();
+			cfgs.owner_id = get_instance_id();
 		}
+		cfgs.epoch = epoch;
+		cfgs.stack.clear();
 	}
 
-	cached_scoped_configs[thread] = default_scoped_config.ptr()->data;
-	return default_scoped_config.ptr()->data;
+	if (foreign_unregisters_count.load(std::memory_order_relaxed)) {
+		_apply_foreign_unregisters(cfgs);
+	}
+	return cfgs;
 }
 
-void DebugDraw3D::_register_scoped_config(uint64_t p_thread_id, uint64_t p_guard_id, DebugDraw3DScopeConfig *p_cfg) {
+void DebugDraw3D::_apply_foreign_unregisters(ThreadScopedConfigs &p_cfgs) {
 	ZoneScoped;
-	LOCK_GUARD(datalock);
+	std::lock_guard<std::mutex> lock(foreign_unregisters_mutex);
 
-	uint64_t thread = OS::get_singleton()->get_thread_caller_id();
-	scoped_configs[p_thread_id].push_back(ScopedPairIdConfig(p_guard_id, p_cfg));
+	auto it = foreign_unregisters.find(p_cfgs.thread_id);
+	if (it == foreign_unregisters.end()) {
+		return;
+	}
 
-	// Update cached value
-	cached_scoped_configs[thread] = p_cfg->data;
+	for (const uint64_t &guard_id : it->second) {
+		_remove_scoped_config(p_cfgs, guard_id);
+		foreign_unregisters_count--;
+	}
+	foreign_unregisters.erase(it);
 }
 
-void DebugDraw3D::_unregister_scoped_config(uint64_t thread_id, uint64_t guard_id) {
+void DebugDraw3D::_remove_scoped_config(ThreadScopedConfigs &p_cfgs, const uint64_t &p_guard_id) {
+	auto &stack = p_cfgs.stack;
+	auto res = std::find_if(stack.rbegin(), stack.rend(), [&p_guard_id](const ScopedPairIdConfig &i) { return i.first == p_guard_id; });
+
+	if (res != stack.rend()) {
+		stack.erase(--res.base());
+		registered_scoped_configs--;
+	}
+}
+
+DebugDraw3DScopeConfig::Data *DebugDraw3D::scoped_config_for_current_thread() {
 	ZoneScoped;
-	LOCK_GUARD(datalock);
+	ThreadScopedConfigs &cfgs = _get_thread_scoped_configs();
+	return cfgs.stack.empty() ? default_scoped_config->data.get() : cfgs.stack.back().second.get();
+}
 
-	auto &cfgs = scoped_configs[thread_id];
-	auto res = std::find_if(cfgs.rbegin(), cfgs.rend(), [&guard_id](const ScopedPairIdConfig &i) { return i.first == guard_id; });
+void DebugDraw3D::_register_scoped_config(uint64_t p_thread_id, uint64_t p_guard_id, DebugDraw3DScopeConfig *p_cfg) {
+	ZoneScoped;
+	// Configs are always registered in the thread where they were created
+	_get_thread_scoped_configs().stack.push_back(ScopedPairIdConfig(p_guard_id, p_cfg->data));
+	registered_scoped_configs++;
+}
 
-	if (res != cfgs.rend()) {
-		cfgs.erase(--res.base());
+void DebugDraw3D::_unregister_scoped_config(uint64_t p_thread_id, uint64_t p_guard_id) {
+	ZoneScoped;
+	ThreadScopedConfigs &cfgs = _get_thread_scoped_configs();
 
-		// Update cached value
-		if (!cfgs.empty()) {
-			cached_scoped_configs[thread_id] = cfgs.back().second->data;
-		} else {
-			cached_scoped_configs[thread_id] = default_scoped_config.ptr()->data;
-		}
+	if (cfgs.thread_id != p_thread_id) {
+		std::lock_guard<std::mutex> lock(foreign_unregisters_mutex);
+		foreign_unregisters[p_thread_id].push_back(p_guard_id);
+		foreign_unregisters_count++;
+		return;
 	}
+
+	_remove_scoped_config(cfgs, p_guard_id);
 }
 
 void DebugDraw3D::_clear_scoped_configs() {
 	ZoneScoped;
-	LOCK_GUARD(datalock);
 
-	uint64_t orphans = 0;
-	for (auto &p : scoped_configs) {
-		orphans += p.second.size();
+	// The orphans will be removed from the stacks by their threads.
+	// The epoch is changed before the counter is reset, so the configs of the old stacks can't be subtracted from the new counter.
+	scoped_configs_epoch++;
+	{
+		std::lock_guard<std::mutex> lock(foreign_unregisters_mutex);
+		foreign_unregisters.clear();
+		foreign_unregisters_count = 0;
 	}
 
-	scoped_stats_3d.created = created_scoped_configs;
-	scoped_stats_3d.orphans = orphans;
-
-	created_scoped_configs = 0;
+	int64_t orphans = std::max(registered_scoped_configs.exchange(0), (int64_t)0);
 
-	cached_scoped_configs.clear();
-	scoped_configs.clear();
+	scoped_stats_3d.created = created_scoped_configs.exchange(0);
+	scoped_stats_3d.orphans = orphans;
 
 	if (orphans)
 		PRINT_ERROR("{0} scoped configs weren't freed. Do not save scoped configurations anywhere other than function bodies.", orphans);
@@ -332,26 +353,34 @@ std::array<Ref<ArrayMesh>, 2> *DebugDraw3D::get_shared_meshes() {
 			// WIREFRAME
 
 			mat_type = MeshMaterialType::Wireframe;
+			GEN_MESH(InstanceType::LINE, GeometryGenerator::CreateMeshNative(Mesh::PrimitiveType::PRIMITIVE_LINES, GeometryGenerator::LineVertexes));
 			GEN_MESH(InstanceType::CUBE, GeometryGenerator::CreateMeshNative(Mesh::PrimitiveType::PRIMITIVE_LINES, GeometryGenerator::CubeVertexes, GeometryGenerator::CubeIndexes));
 			GEN_MESH(InstanceType::CUBE_CENTERED, GeometryGenerator::CreateMeshNative(Mesh::PrimitiveType::PRIMITIVE_LINES, GeometryGenerator::CenteredCubeVertexes, GeometryGenerator::CubeIndexes));
 			GEN_MESH(InstanceType::ARROWHEAD, GeometryGenerator::CreateMeshNative(Mesh::PrimitiveType::PRIMITIVE_LINES, GeometryGenerator::ArrowheadVertexes, GeometryGenerator::ArrowheadIndexes));
 			GEN_MESH(InstanceType::POSITION, GeometryGenerator::CreateMeshNative(Mesh::PrimitiveType::PRIMITIVE_LINES, GeometryGenerator::PositionVertexes, GeometryGenerator::PositionIndexes));
+			GEN_MESH(InstanceType::SPHERE_LD, p_use_icosphere ? GeometryGenerator::CreateIcosphereLines(0.5f, 0) : GeometryGenerator::CreateSphereLines(4, 4, 0.5f, 2));
 			GEN_MESH(InstanceType::SPHERE, p_use_icosphere ? GeometryGenerator::CreateIcosphereLines(0.5f, 1) : GeometryGenerator::CreateSphereLines(8, 8, 0.5f, 2));
 			GEN_MESH(InstanceType::SPHERE_HD, p_use_icosphere_hd ? GeometryGenerator::CreateIcosphereLines(0.5f, 2) : GeometryGenerator::CreateSphereLines(16, 16, 0.5f, 2));
+			GEN_MESH(InstanceType::CYLINDER_LD, GeometryGenerator::CreateCylinderLines(8, 1, 1, 2));
 			GEN_MESH(InstanceType::CYLINDER, GeometryGenerator::CreateCylinderLines(16, 1, 1, 2));
+			GEN_MESH(InstanceType::CYLINDER_AB_LD, GeometryGenerator::RotatedMesh(GeometryGenerator::CreateCylinderLines(8, 1, 1, 2), Vector3_RIGHT, Math::deg_to_rad(90.f)));
 			GEN_MESH(InstanceType::CYLINDER_AB, GeometryGenerator::RotatedMesh(GeometryGenerator::CreateCylinderLines(16, 1, 1, 2), Vector3_RIGHT, Math::deg_to_rad(90.f)));
 
 			// VOLUMETRIC
 
+			mat_type = MeshMaterialType::ExtendableLine;
+			GEN_MESH(InstanceType::LINE_VOLUMETRIC, GeometryGenerator::ConvertWireframeToVolumetric(shared_generated_meshes[(int)InstanceType::LINE][i], p_add_bevel));
 			mat_type = MeshMaterialType::Extendable;
-			GEN_MESH(InstanceType::LINE_VOLUMETRIC, GeometryGenerator::ConvertWireframeToVolumetric(GeometryGenerator::CreateMeshNative(Mesh::PrimitiveType::PRIMITIVE_LINES, GeometryGenerator::LineVertexes), p_add_bevel));
 			GEN_MESH(InstanceType::CUBE_VOLUMETRIC, GeometryGenerator::ConvertWireframeToVolumetric(shared_generated_meshes[(int)InstanceType::CUBE][i], p_add_bevel));
 			GEN_MESH(InstanceType::CUBE_CENTERED_VOLUMETRIC, GeometryGenerator::ConvertWireframeToVolumetric(shared_generated_meshes[(int)InstanceType::CUBE_CENTERED][i], p_add_bevel));
 			GEN_MESH(InstanceType::ARROWHEAD_VOLUMETRIC, GeometryGenerator::CreateVolumetricArrowHead(.25f, 1.f, 1.f, p_add_bevel));
 			GEN_MESH(InstanceType::POSITION_VOLUMETRIC, GeometryGenerator::ConvertWireframeToVolumetric(shared_generated_meshes[(int)InstanceType::POSITION][i], p_add_bevel));
+			GEN_MESH(InstanceType::SPHERE_LD_VOLUMETRIC, GeometryGenerator::ConvertWireframeToVolumetric(shared_generated_meshes[(int)InstanceType::SPHERE_LD][i], false));
 			GEN_MESH(InstanceType::SPHERE_VOLUMETRIC, GeometryGenerator::ConvertWireframeToVolumetric(shared_generated_meshes[(int)InstanceType::SPHERE][i], false));
 			GEN_MESH(InstanceType::SPHERE_HD_VOLUMETRIC, GeometryGenerator::ConvertWireframeToVolumetric(shared_generated_meshes[(int)InstanceType::SPHERE_HD][i], false));
+			GEN_MESH(InstanceType::CYLINDER_LD_VOLUMETRIC, GeometryGenerator::ConvertWireframeToVolumetric(shared_generated_meshes[(int)InstanceType::CYLINDER_LD][i], false));
 			GEN_MESH(InstanceType::CYLINDER_VOLUMETRIC, GeometryGenerator::ConvertWireframeToVolumetric(shared_generated_meshes[(int)InstanceType::CYLINDER][i], false));
+			GEN_MESH(InstanceType::CYLINDER_AB_LD_VOLUMETRIC, GeometryGenerator::ConvertWireframeToVolumetric(shared_generated_meshes[(int)InstanceType::CYLINDER_AB_LD][i], false));
 			GEN_MESH(InstanceType::CYLINDER_AB_VOLUMETRIC, GeometryGenerator::ConvertWireframeToVolumetric(shared_generated_meshes[(int)InstanceType::CYLINDER_AB][i], false));
 
 			// SOLID
@@ -368,54 +397,75 @@ std::array<Ref<ArrayMesh>, 2> *DebugDraw3D::get_shared_meshes() {
 	return shared_generated_meshes.data();
 }
 
-std::shared_ptr<DebugGeometryContainer> DebugDraw3D::create_debug_container(bool p_no_depth_test) {
-	return std::make_shared<DebugGeometryContainer>(this, p_no_depth_test);
+std::shared_ptr<DebugGeometryContainer> DebugDraw3D::create_debug_container() {
+	return std::make_shared<DebugGeometryContainer>(this);
 }
 
 std::shared_ptr<DebugGeometryContainer> DebugDraw3D::get_debug_container(const DebugDraw3DScopeConfig::DebugContainerDependent &p_dgcd, const bool p_generate_new_container) {
 	ZoneScoped;
 	LOCK_GUARD(datalock);
 
-	if (!p_dgcd.viewport) {
+	// The viewport can be freed before the recorded commands are merged
+	if (!p_dgcd.viewport || !UtilityFunctions::is_instance_id_valid(p_dgcd.viewport_id)) {
 		return nullptr;
 	}
 
-	int dgc_depth = !!p_dgcd.no_depth_test;
-
+	// The depth test mode is resolved by the GeometryPool of the container
 	if (const auto &cached_world = viewport_to_world_cache.find(p_dgcd.viewport);
-			cached_world != viewport_to_world_cache.end() && cached_world->second.dgcs[dgc_depth]) {
-		return cached_world->second.dgcs[dgc_depth];
+			cached_world != viewport_to_world_cache.end() && cached_world->second.dgc) {
+		return cached_world->second.dgc;
 	}
 
 	Ref<World3D> vp_world = p_dgcd.viewport->find_world_3d();
 	uint64_t vp_world_id = vp_world->get_instance_id();
 
 	if (const auto &dgc_pair = debug_containers.find(vp_world_id);
-			dgc_pair != debug_containers.end() && dgc_pair->second[dgc_depth]) {
+			dgc_pair != debug_containers.end()) {
 
 		auto &cache = viewport_to_world_cache[p_dgcd.viewport];
 		cache.world_id = dgc_pair->first;
-		cache.dgcs[dgc_depth] = dgc_pair->second[dgc_depth];
-		return dgc_pair->second[dgc_depth];
+		cache.dgc = dgc_pair->second;
+		return dgc_pair->second;
 	}
 
 	if (!p_generate_new_container) {
 		return nullptr;
 	}
 
-	auto dgc = create_debug_container(p_dgcd.no_depth_test);
+	auto dgc = create_debug_container();
 	dgc->set_world(vp_world);
-	debug_containers[vp_world_id][dgc_depth] = dgc;
+	debug_containers[vp_world_id] = dgc;
 
 	auto &cache = viewport_to_world_cache[p_dgcd.viewport];
 	cache.world_id = vp_world_id;
-	cache.dgcs[dgc_depth] = dgc;
+	cache.dgc = dgc;
 
 	call_deferred(NAMEOF(_register_viewport_world_deferred), _get_root_world_viewport(p_dgcd.viewport)->get_instance_id(), vp_world_id);
 
 	return dgc;
 }
 
+#ifdef DEBUG_ENABLED
+Array DebugDraw3D::_get_segment_transforms(const PackedVector3Array &p_lines, const PackedFloat32Array &p_radii) {
+	size_t count = p_lines.size() / 2;
+	ERR_FAIL_COND_V(p_radii.size() < (int64_t)count, Array());
+
+	std::vector<Transform3D> cylinders(count);
+	std::vector<Transform3D> endpoints(count);
+	std::vector<SphereBounds> bounds(count);
+	MathUtils::get_cylinder_ab_transforms(p_lines.ptr(), count, p_radii.ptr(), 1, cylinders.data(), bounds.data());
+	MathUtils::get_line_segment_endpoint_transforms(p_lines.ptr(), count, endpoints.data(), bounds.data());
+
+	Array res_cylinders;
+	Array res_endpoints;
+	for (size_t i = 0; i < count; i++) {
+		res_cylinders.push_back(cylinders[i]);
+		res_endpoints.push_back(endpoints[i]);
+	}
+	return Array::make(res_cylinders, res_endpoints);
+}
+#endif
+
 void DebugDraw3D::_register_viewport_world_deferred(uint64_t /*Viewport * */ vp_id, const uint64_t p_world_id) {
 	ZoneScoped;
 
@@ -466,27 +516,275 @@ void DebugDraw3D::_remove_debug_container(const uint64_t &p_world_id) {
 	}
 }
 
+// The same projection as in `Camera3D::get_frustum`
+static Projection _get_camera_projection(const Camera3D *p_cam) {
+	Vector2 vp_size = p_cam->get_viewport()->get_visible_rect().size;
+	real_t aspect = vp_size.y > 0 ? vp_size.aspect() : 1;
+	bool flip_fov = p_cam->get_keep_aspect_mode() == Camera3D::KEEP_WIDTH;
+
+	Projection cm;
+	switch (p_cam->get_projection()) {
+		case Camera3D::PROJECTION_PERSPECTIVE:
+			cm.set_perspective(p_cam->get_fov(), aspect, p_cam->get_near(), p_cam->get_far(), flip_fov);
+			break;
+		case Camera3D::PROJECTION_ORTHOGONAL:
+			cm.set_orthogonal(p_cam->get_size(), aspect, p_cam->get_near(), p_cam->get_far(), flip_fov);
+			break;
+		case Camera3D::PROJECTION_FRUSTUM:
+			cm.set_frustum(p_cam->get_size(), aspect, p_cam->get_frustum_offset(), p_cam->get_near(), p_cam->get_far(), flip_fov);
+			break;
+	}
+	return cm;
+}
+
+std::shared_ptr<GeometryPoolCullingData> DebugDraw3D::_get_culling_data(Viewport *p_vp) {
+	ZoneScoped;
+	if (const auto &it = frame_culling_data.find(p_vp); it != frame_culling_data.end()) {
+		return it->second;
+	}
+
+	std::vector<std::array<Plane, 6> > frustum_planes;
+	std::vector<AABBMinMax> frustum_boxes;
+	std::vector<GeometryPoolCamera> cameras;
+
+	std::vector<Camera3D *> frustum_cameras;
+	frustum_cameras.reserve(1);
+
+#ifdef DEBUG_ENABLED
+	auto custom_editor_viewports = get_custom_editor_viewports();
+	bool is_editor_vp = std::find_if(
+								custom_editor_viewports.cbegin(),
+								custom_editor_viewports.cend(),
+								[&p_vp](const auto &it) { return it == p_vp; }) != custom_editor_viewports.cend();
+
+	if (IS_EDITOR_HINT() && is_editor_vp) {
+		Camera3D *cam = nullptr;
+		Node *root = SCENE_TREE()->get_edited_scene_root();
+		if (root) {
+			cam = root->get_viewport()->get_camera_3d();
+		}
+
+		if (config->is_force_use_camera_from_scene() && cam) {
+			frustum_cameras.push_back(cam);
+		} else if (custom_editor_viewports.size() > 0) {
+			for (const auto &evp : custom_editor_viewports) {
+				if (evp->get_update_mode() == SubViewport::UpdateMode::UPDATE_ALWAYS) {
+					Camera3D *cam = evp->get_camera_3d();
+					if (cam) {
+						frustum_cameras.push_back(cam);
+					}
+				}
+			}
+		}
+	} else {
+#endif
+		Camera3D *vp_cam = p_vp->get_camera_3d();
+		if (vp_cam) {
+			frustum_cameras.push_back(vp_cam);
+		}
+#ifdef DEBUG_ENABLED
+	}
+#endif
+
+	for (Camera3D *cam : frustum_cameras) {
+		Transform3D cam_xf = cam->get_camera_transform();
+		std::array<Plane, 6> a = MathUtils::get_projection_planes(_get_camera_projection(cam), cam_xf);
+		MathUtils::scale_frustum_far_plane_distance(a, cam->get_global_transform(), config->get_frustum_length_scale());
+
+		if (config->is_use_frustum_culling())
+			frustum_planes.push_back(a);
+
+		auto cube = MathUtils::get_frustum_cube(a);
+		AABB aabb = MathUtils::calculate_vertex_bounds(cube.data(), cube.size());
+		frustum_boxes.push_back(aabb);
+
+		GeometryPoolCamera pool_cam;
+		pool_cam.position = cam->get_global_position();
+		pool_cam.viewport_height = cam->get_viewport()->get_visible_rect().size.y;
+		pool_cam.is_orthogonal = cam->get_projection() == Camera3D::PROJECTION_ORTHOGONAL;
+		if (pool_cam.is_orthogonal) {
+			pool_cam.size_scale = cam->get_size() > 0 ? 2 / cam->get_size() : 0;
+		} else {
+			pool_cam.size_scale = 1 / Math::tan(Math::deg_to_rad(cam->get_fov()) * 0.5f);
+		}
+		cameras.push_back(pool_cam);
+	}
+
+	auto res = std::make_shared<GeometryPoolCullingData>(frustum_planes, frustum_boxes, cameras, config->get_lod_low_detail_size(), config->get_lod_high_detail_size(), config->get_culling_min_pixel_radius());
+	frame_culling_data[p_vp] = res;
+	return res;
+}
+
+DebugDraw3D::ThreadBatch &DebugDraw3D::_get_thread_batch() {
+	thread_local ThreadBatch batch;
+	return batch;
+}
+
+DebugDraw3D::ThreadBatch *DebugDraw3D::_get_active_batch() {
+	ThreadBatch &batch = _get_thread_batch();
+	// The batch is dropped when the scoped configs are cleared
+	if (batch.depth && batch.owner == this && batch.epoch == scoped_configs_epoch.load(std::memory_order_acquire)) {
+		return &batch;
+	}
+	return nullptr;
+}
+
+DebugDraw3DScopeConfig::Data *DebugDraw3D::_get_batch_scoped_config(ThreadBatch *p_batch) {
+	// Scoped configs created inside the batch are pushed to the same stack
+	const auto &stack = p_batch->scoped_configs->stack;
+	return stack.empty() ? default_scoped_config->data.get() : stack.back().second.get();
+}
+
+ThreadDrawCommands *DebugDraw3D::_get_thread_draw_commands() {
+	if (ThreadBatch *batch = _get_active_batch()) {
+		return batch->commands;
+	}
+
+	// DebugDraw3D can be recreated, so the owner of the buffer is also checked
+	struct ThreadCommandsHolder {
+		uint64_t owner_id = 0;
+		std::shared_ptr<ThreadDrawCommands> commands;
+
+		~ThreadCommandsHolder() {
+			if (commands) {
+				commands->mark_thread_exited();
+			}
+		}
+	};
+	thread_local ThreadCommandsHolder holder;
+
+	if (holder.owner_id != get_instance_id()) {
+		ZoneScopedN("Register thread commands");
+		if (holder.commands) {
+			holder.commands->mark_thread_exited();
+		}
+
+		std::lock_guard<std::mutex> lock(thread_draw_commands_mutex);
+		holder.commands = thread_draw_commands.emplace_back(std::make_shared<ThreadDrawCommands>());
+		holder.owner_id = get_instance_id();
+	}
+	return holder.commands.get();
+}
+
+void DebugDraw3D::_flush_draw_commands(const bool &p_discard) {
+	ZoneScoped;
+	LOCK_GUARD(datalock);
+	std::lock_guard<std::mutex> lock(thread_draw_commands_mutex);
+
+	std::vector<std::shared_ptr<DebugGeometryContainer> > dgcs;
+	std::vector<const ThreadDrawCommands *> exited_threads;
+	for (auto &tc : thread_draw_commands) {
+		// Checked before the swap, so all the commands of the exited thread are in the swapped buffer
+		if (tc->is_thread_exited()) {
+			exited_threads.push_back(tc.get());
+		}
+
+		DrawCommands *cmds = tc->swap();
+		if (p_discard || cmds->empty()) {
+			cmds->clear();
+			continue;
+		}
+
+		// Resolve containers once for each config
+		dgcs.resize(cmds->configs.size());
+		for (size_t i = 0; i < cmds->configs.size(); i++) {
+			dgcs[i] = get_debug_container(cmds->configs[i]->dcd, true);
+		}
+
+		for (const auto &i : cmds->instances) {
+			const auto &dgc = dgcs[i.config];
+			if (!dgc) {
+				continue;
+			}
+
+			const Color *custom_col = i.has_custom_color ? &i.custom_color : nullptr;
+			if (i.is_convertable_type) {
+				dgc->geometry_pool.add_or_update_instance(cmds->configs[i.config], (ConvertableInstanceType)i.type, i.exp_time, i.proc, i.transform, i.color, i.bounds, custom_col);
+			} else {
+				dgc->geometry_pool.add_or_update_instance(cmds->configs[i.config], (InstanceType)i.type, i.exp_time, i.proc, i.transform, i.color, i.bounds, custom_col);
+			}
+		}
+
+		for (const auto &b : cmds->batches) {
+			const auto &dgc = dgcs[b.config];
+			if (!dgc) {
+				continue;
+			}
+
+			const Color *custom_col = b.has_custom_color ? &b.custom_color : nullptr;
+			const Transform3D *transforms = cmds->batch_transforms.data() + b.offset;
+			const Color *colors = cmds->batch_colors.data() + b.offset;
+			const SphereBounds *bounds = cmds->batch_bounds.data() + b.offset;
+			if (b.is_convertable_type) {
+				dgc->geometry_pool.add_or_update_instances(cmds->configs[b.config], (ConvertableInstanceType)b.type, b.exp_time, b.proc, transforms, colors, bounds, b.count, custom_col);
+			} else {
+				dgc->geometry_pool.add_or_update_instances(cmds->configs[b.config], (InstanceType)b.type, b.exp_time, b.proc, transforms, colors, bounds, b.count, custom_col);
+			}
+		}
+
+		for (const auto &l : cmds->lines) {
+			const auto &dgc = dgcs[l.config];
+			if (!dgc) {
+				continue;
+			}
+
+			dgc->geometry_pool.add_or_update_line(cmds->configs[l.config], l.exp_time, l.proc, cmds->points->data() + l.offset, l.count, l.color, cmds->points);
+		}
+
+		dgcs.clear();
+		cmds->clear();
+	}
+
+	if (exited_threads.size()) {
+		thread_draw_commands.erase(
+				std::remove_if(thread_draw_commands.begin(), thread_draw_commands.end(), [&exited_threads](const std::shared_ptr<ThreadDrawCommands> &tc) {
+					return std::find(exited_threads.begin(), exited_threads.end(), tc.get()) != exited_threads.end();
+				}),
+				thread_draw_commands.end());
+	}
+}
+
+void DebugDraw3D::_add_instance(DebugDraw3DScopeConfig::Data *p_cfg, ConvertableInstanceType p_type, const real_t &p_exp_time, const ProcessType &p_proc, const Transform3D &p_transform, const Color &p_col, const SphereBounds &p_bounds, const Color *p_custom_col) {
+	ThreadDrawCommands *tc = _get_thread_draw_commands();
+	DrawCommands *cmds = tc->begin_write();
+	cmds->add_instance(p_cfg, (int)p_type, true, p_exp_time, p_proc, p_transform, p_col, p_bounds, p_custom_col);
+	tc->end_write(cmds);
+}
+
+void DebugDraw3D::_add_instance(DebugDraw3DScopeConfig::Data *p_cfg, InstanceType p_type, const real_t &p_exp_time, const ProcessType &p_proc, const Transform3D &p_transform, const Color &p_col, const SphereBounds &p_bounds, const Color *p_custom_col) {
+	ThreadDrawCommands *tc = _get_thread_draw_commands();
+	DrawCommands *cmds = tc->begin_write();
+	cmds->add_instance(p_cfg, (int)p_type, false, p_exp_time, p_proc, p_transform, p_col, p_bounds, p_custom_col);
+	tc->end_write(cmds);
+}
+
+void DebugDraw3D::_add_lines(DebugDraw3DScopeConfig::Data *p_cfg, const real_t &p_exp_time, const ProcessType &p_proc, const Vector3 *p_lines, const size_t p_line_count, const Color &p_col) {
+	ThreadDrawCommands *tc = _get_thread_draw_commands();
+	DrawCommands *cmds = tc->begin_write();
+	cmds->add_lines(p_cfg, p_exp_time, p_proc, p_lines, p_line_count, p_col);
+	tc->end_write(cmds);
+}
+
 #endif
 
 Ref<DebugDraw3DScopeConfig> DebugDraw3D::new_scoped_config() {
 	ZoneScoped;
 #ifndef DISABLE_DEBUG_RENDERING
-	LOCK_GUARD(datalock);
 	static std::atomic<uint64_t> create_counter = 0;
-	create_counter++;
+	uint64_t guard_id = ++create_counter;
 
-	uint64_t thread = OS::get_singleton()->get_thread_caller_id();
+	uint64_t thread = _get_thread_scoped_configs().thread_id;
 	auto unreg_func = [this](const uint64_t &p_thread_id, const uint64_t &p_guard_id) {
 		_unregister_scoped_config(p_thread_id, p_guard_id);
 	};
 	Ref<DebugDraw3DScopeConfig> res(memnew(
 			DebugDraw3DScopeConfig(
 					thread,
-					create_counter,
+					guard_id,
 					scoped_config_for_current_thread(),
 					unreg_func)));
 
-	_register_scoped_config(thread, create_counter, res.ptr());
+	_register_scoped_config(thread, guard_id, res.ptr());
 	created_scoped_configs++;
 	return res;
 #else
@@ -498,6 +796,47 @@ Ref<DebugDraw3DScopeConfig> DebugDraw3D::scoped_config() {
 	return default_scoped_config;
 }
 
+void DebugDraw3D::begin_batch() {
+	ZoneScoped;
+#ifndef DISABLE_DEBUG_RENDERING
+	if (ThreadBatch *active = _get_active_batch()) {
+		active->depth++;
+		return;
+	}
+
+	ThreadBatch &batch = _get_thread_batch();
+	batch.depth = 0;
+	batch.owner = this;
+	batch.scoped_configs = &_get_thread_scoped_configs();
+	batch.epoch = batch.scoped_configs->epoch;
+	batch.commands = _get_thread_draw_commands();
+	batch.proc = Engine::get_singleton()->is_in_physics_frame() ? ProcessType::PHYSICS_PROCESS : ProcessType::PROCESS;
+	batch.depth = 1;
+#endif
+}
+
+void DebugDraw3D::end_batch() {
+	ZoneScoped;
+#ifndef DISABLE_DEBUG_RENDERING
+	ThreadBatch &batch = _get_thread_batch();
+	if (batch.depth) {
+		batch.depth--;
+	}
+#endif
+}
+
+Ref<DebugDraw3DBatchScope> DebugDraw3D::new_batch_scope() {
+	ZoneScoped;
+#ifndef DISABLE_DEBUG_RENDERING
+	begin_batch();
+
+	uint64_t thread = _get_thread_scoped_configs().thread_id;
+	return Ref<DebugDraw3DBatchScope>(memnew(DebugDraw3DBatchScope(thread, [this]() { end_batch(); })));
+#else
+	return Ref<DebugDraw3DBatchScope>(memnew(DebugDraw3DBatchScope));
+#endif
+}
+
 void DebugDraw3D::_load_materials() {
 	ZoneScoped;
 #ifndef DISABLE_DEBUG_RENDERING
@@ -541,6 +880,7 @@ void DebugDraw3D::_load_materials() {
 		LOAD_SHADER(mesh_shaders[(int)MeshMaterialType::Billboard][variant], prefix + DD3DResources::src_resources_billboard_unshaded_gdshader);
 		LOAD_SHADER(mesh_shaders[(int)MeshMaterialType::Plane][variant], prefix + DD3DResources::src_resources_plane_unshaded_gdshader);
 		LOAD_SHADER(mesh_shaders[(int)MeshMaterialType::Extendable][variant], prefix + DD3DResources::src_resources_extendable_meshes_gdshader);
+		LOAD_SHADER(mesh_shaders[(int)MeshMaterialType::ExtendableLine][variant], prefix + "#define LINE_FROM_ENDPOINTS\n" + DD3DResources::src_resources_extendable_meshes_gdshader);
 	}
 #undef LOAD_SHADER
 #endif
@@ -609,12 +949,8 @@ Ref<DebugDraw3DStats> DebugDraw3D::get_render_stats() {
 	stats_3d.instantiate();
 
 	for (const auto &p : debug_containers) {
-		for (const auto &dgc : p.second) {
-			if (dgc) {
-				dgc->get_render_stats(stats_3d);
-				res->combine_with(stats_3d);
-			}
-		}
+		p.second->get_render_stats(stats_3d);
+		res->combine_with(stats_3d);
 	}
 	res->set_scoped_config_stats(scoped_stats_3d.created, scoped_stats_3d.orphans);
 #endif
@@ -628,12 +964,10 @@ Ref<DebugDraw3DStats> DebugDraw3D::get_render_stats_for_world(Viewport *viewport
 	Ref<DebugDraw3DStats> stats_3d;
 	stats_3d.instantiate();
 
-	for (int i = 0; i < 2; i++) {
-		auto dgc = get_debug_container(DebugDraw3DScopeConfig::DebugContainerDependent(viewport, i > 0), false);
-		if (dgc) {
-			dgc->get_render_stats(stats_3d);
-			res->combine_with(stats_3d);
-		}
+	auto dgc = get_debug_container(DebugDraw3DScopeConfig::DebugContainerDependent(viewport, false), false);
+	if (dgc) {
+		dgc->get_render_stats(stats_3d);
+		res->combine_with(stats_3d);
 	}
 #endif
 	return res;
@@ -650,15 +984,10 @@ void DebugDraw3D::regenerate_geometry_meshes() {
 	shared_generated_meshes.clear();
 
 	for (auto &p : debug_containers) {
-		for (int i = 0; i < 2; i++) {
-			if (p.second[i]) {
-				Ref<World3D> old_world = p.second[i]->get_world();
-				bool no_depth = p.second[i]->is_no_depth_test();
+		Ref<World3D> old_world = p.second->get_world();
 
-				p.second[i] = create_debug_container(no_depth);
-				p.second[i]->set_world(old_world);
-			}
-		}
+		p.second = create_debug_container();
+		p.second->set_world(old_world);
 	}
 #endif
 }
@@ -666,12 +995,10 @@ void DebugDraw3D::regenerate_geometry_meshes() {
 void DebugDraw3D::clear_all() {
 	ZoneScoped;
 #ifndef DISABLE_DEBUG_RENDERING
+	_flush_draw_commands(true);
+
 	for (auto &p : debug_containers) {
-		for (const auto &dgc : p.second) {
-			if (dgc) {
-				dgc->clear_3d_objects();
-			}
-		}
+		p.second->clear_3d_objects();
 	}
 #else
 	return;
@@ -680,15 +1007,15 @@ void DebugDraw3D::clear_all() {
 
 #ifndef DISABLE_DEBUG_RENDERING
 #define IS_DEFAULT_COLOR(name) (name == Colors::empty_color)
-#define GET_PROC_TYPE() (Engine::get_singleton()->is_in_physics_frame() ? ProcessType::PHYSICS_PROCESS : ProcessType::PROCESS)
+#define GET_PROC_TYPE() (batch ? batch->proc : (Engine::get_singleton()->is_in_physics_frame() ? ProcessType::PHYSICS_PROCESS : ProcessType::PROCESS))
 #define CHECK_BEFORE_CALL() \
 	if (NEED_LEAVE || config->is_freeze_3d_render()) return;
 #endif
 
-#define GET_SCOPED_CFG_AND_DGC()                     \
-	auto scfg = scoped_config_for_current_thread();  \
-	auto dgc = get_debug_container(scfg->dcd, true); \
-	if (!dgc) return
+#define GET_SCOPED_CFG()                                                                      \
+	ThreadBatch *batch = _get_active_batch();                                                 \
+	auto scfg = batch ? _get_batch_scoped_config(batch) : scoped_config_for_current_thread(); \
+	if (!scfg->dcd.viewport) return
 
 #ifndef DISABLE_DEBUG_RENDERING
 
@@ -706,36 +1033,35 @@ Vector3 DebugDraw3D::get_up_vector(const Vector3 &p_dir) {
 	return Vector3_UP;
 }
 
-void DebugDraw3D::add_or_update_line_with_thickness(real_t p_exp_time, std::unique_ptr<Vector3[]> p_lines, const size_t p_line_count, const Color &p_col, const std::function<void(DelayedRendererLine *)> p_custom_upd) {
+void DebugDraw3D::add_or_update_line_with_thickness(real_t p_exp_time, const Vector3 *p_lines, const size_t p_line_count, const Color &p_col) {
 	ZoneScoped;
 
-	LOCK_GUARD(datalock);
-	GET_SCOPED_CFG_AND_DGC();
+	GET_SCOPED_CFG();
 
-	if (!scfg->thickness) {
-		dgc->geometry_pool.add_or_update_line(
+	if (!scfg->thickness && !config->is_use_instanced_lines()) {
+		_add_lines(
 				scfg,
 				p_exp_time,
 				GET_PROC_TYPE(),
-				std::move(p_lines),
+				p_lines,
 				p_line_count,
 				p_col);
 	} else {
-		for (int i = 0; i < p_line_count; i += 2) {
-			ZoneScopedN("Convert AB to xf");
-			Vector3 a = p_lines.get()[i];
-			Vector3 diff = p_lines.get()[i + 1] - a;
-			real_t len = diff.length();
-			Vector3 center = diff.normalized() * len * .5f;
-			dgc->geometry_pool.add_or_update_instance(
-					scfg,
-					InstanceType::LINE_VOLUMETRIC,
-					p_exp_time,
-					GET_PROC_TYPE(),
-					Transform3D(Basis().looking_at(center, get_up_vector(center)).scaled(VEC3_ONE(len)), a), // slow
-					p_col,
-					SphereBounds(a + center, len * .5f));
-		}
+		// Wireframe and volumetric lines use the same unit segment, so only the endpoints are written
+		size_t count = p_line_count / 2;
+		_add_instances(
+				scfg,
+				(int)(scfg->thickness ? InstanceType::LINE_VOLUMETRIC : InstanceType::LINE),
+				false,
+				p_exp_time,
+				GET_PROC_TYPE(),
+				count,
+				nullptr,
+				[&](Transform3D *r_transforms, Color *r_colors, SphereBounds *r_bounds) {
+					ZoneScopedN("Pack AB to xf");
+					MathUtils::get_line_segment_endpoint_transforms(p_lines, count, r_transforms, r_bounds);
+					std::fill(r_colors, r_colors + count, p_col);
+				});
 	}
 }
 
@@ -745,10 +1071,9 @@ void DebugDraw3D::draw_sphere_base(const Transform3D &transform, const Color &co
 	ZoneScoped;
 	CHECK_BEFORE_CALL();
 
-	LOCK_GUARD(datalock);
-	GET_SCOPED_CFG_AND_DGC();
+	GET_SCOPED_CFG();
 
-	dgc->geometry_pool.add_or_update_instance(
+	_add_instance(
 			scfg,
 			ConvertableInstanceType::SPHERE,
 			duration,
@@ -771,6 +1096,45 @@ void DebugDraw3D::draw_sphere_xf(const Transform3D &transform, const Color &colo
 	draw_sphere_base(transform, color, duration);
 }
 
+void DebugDraw3D::_draw_spheres(const Vector3 *p_positions, const size_t &p_count, const float *p_radii, const size_t &p_radii_step, const Color *p_colors, const Color &p_color, const real_t &p_duration) {
+	ZoneScoped;
+	GET_SCOPED_CFG();
+
+	const Color def_color = IS_DEFAULT_COLOR(p_color) ? Colors::chartreuse : p_color;
+
+	_add_instances(
+			scfg,
+			(int)ConvertableInstanceType::SPHERE,
+			true,
+			p_duration,
+			GET_PROC_TYPE(),
+			p_count,
+			nullptr,
+			[&](Transform3D *r_transforms, Color *r_colors, SphereBounds *r_bounds) {
+				for (size_t i = 0; i < p_count; i++) {
+					real_t radius = p_radii[i * p_radii_step];
+					real_t scale = radius * 2;
+					r_transforms[i] = Transform3D(scale, 0, 0, 0, scale, 0, 0, 0, scale, p_positions[i].x, p_positions[i].y, p_positions[i].z);
+					r_colors[i] = p_colors && !IS_DEFAULT_COLOR(p_colors[i]) ? p_colors[i] : def_color;
+					r_bounds[i] = SphereBounds(p_positions[i], Math::abs(radius));
+				}
+			});
+}
+
+void DebugDraw3D::draw_spheres(const PackedVector3Array &positions, const PackedFloat32Array &radii, const PackedColorArray &colors, const Color &color, const real_t &duration) {
+	ZoneScoped;
+	CHECK_BEFORE_CALL();
+
+	const int64_t count = positions.size();
+	if (!count) {
+		return;
+	}
+	ERR_FAIL_COND_MSG(radii.size() != 1 && radii.size() != count, "The number of radii must be 1 or equal to the number of positions.");
+	ERR_FAIL_COND_MSG(colors.size() && colors.size() != count, "The number of colors must be 0 or equal to the number of positions.");
+
+	_draw_spheres(positions.ptr(), count, radii.ptr(), radii.size() == 1 ? 0 : 1, colors.size() ? colors.ptr() : nullptr, color, duration);
+}
+
 #pragma endregion // Spheres
 #pragma region Cylinders
 
@@ -778,10 +1142,9 @@ void DebugDraw3D::draw_cylinder(const Transform3D &transform, const Color &color
 	ZoneScoped;
 	CHECK_BEFORE_CALL();
 
-	LOCK_GUARD(datalock);
-	GET_SCOPED_CFG_AND_DGC();
+	GET_SCOPED_CFG();
 
-	dgc->geometry_pool.add_or_update_instance(
+	_add_instance(
 			scfg,
 			ConvertableInstanceType::CYLINDER,
 			duration,
@@ -795,24 +1158,58 @@ void DebugDraw3D::draw_cylinder_ab(const Vector3 &a, const Vector3 &b, const rea
 	ZoneScoped;
 	CHECK_BEFORE_CALL();
 
-	// TODO maybe someone knows a better way to solve it?
-	Vector3 diff = b - a;
-	real_t len = diff.length();
-	Vector3 half_center = diff.normalized() * len * .5f;
-	Vector3 up = get_up_vector(half_center);
-	Transform3D t = Transform3D(Basis().looking_at(half_center, up).scaled_local(Vector3(radius, radius, len)), a + half_center);
+	const Vector3 ab[2] = { a, b };
+	const float r = (float)radius;
+	Transform3D t;
+	SphereBounds sb;
+	MathUtils::get_cylinder_ab_transforms(ab, 1, &r, 0, &t, &sb);
 
-	LOCK_GUARD(datalock);
-	GET_SCOPED_CFG_AND_DGC();
+	GET_SCOPED_CFG();
 
-	dgc->geometry_pool.add_or_update_instance(
+	_add_instance(
 			scfg,
 			ConvertableInstanceType::CYLINDER_AB,
 			duration,
 			GET_PROC_TYPE(),
 			t,
 			IS_DEFAULT_COLOR(color) ? Colors::forest_green : color,
-			SphereBounds(t.origin, MathUtils::get_max_basis_length(t.basis) * MathUtils::CylinderRadiusForSphere));
+			sb);
+}
+
+void DebugDraw3D::draw_cylinders_ab(const PackedVector3Array &points, const PackedFloat32Array &radii, const PackedColorArray &colors, const Color &color, const real_t &duration) {
+	ZoneScoped;
+	CHECK_BEFORE_CALL();
+
+	const int64_t count = points.size() / 2;
+	ERR_FAIL_COND_MSG(points.size() % 2, "The number of points must be even.");
+	if (!count) {
+		return;
+	}
+	ERR_FAIL_COND_MSG(radii.size() != 1 && radii.size() != count, "The number of radii must be 1 or equal to the number of cylinders.");
+	ERR_FAIL_COND_MSG(colors.size() && colors.size() != count, "The number of colors must be 0 or equal to the number of cylinders.");
+
+	GET_SCOPED_CFG();
+
+	const Vector3 *p = points.ptr();
+	const float *r = radii.ptr();
+	const size_t r_step = radii.size() == 1 ? 0 : 1;
+	const Color *cols = colors.size() ? colors.ptr() : nullptr;
+	const Color def_color = IS_DEFAULT_COLOR(color) ? Colors::forest_green : color;
+
+	_add_instances(
+			scfg,
+			(int)ConvertableInstanceType::CYLINDER_AB,
+			true,
+			duration,
+			GET_PROC_TYPE(),
+			count,
+			nullptr,
+			[&](Transform3D *r_transforms, Color *r_colors, SphereBounds *r_bounds) {
+				MathUtils::get_cylinder_ab_transforms(p, count, r, r_step, r_transforms, r_bounds);
+				for (int64_t i = 0; i < count; i++) {
+					r_colors[i] = cols && !IS_DEFAULT_COLOR(cols[i]) ? cols[i] : def_color;
+				}
+			});
 }
 
 #pragma endregion // Cylinders
@@ -844,10 +1241,9 @@ void DebugDraw3D::draw_box_ab(const Vector3 &a, const Vector3 &b, const Vector3
 		// copied from draw_box_xf
 		SphereBounds sb(t.origin + half_center_orig, MathUtils::get_max_basis_length(t.basis) * MathUtils::CubeRadiusForSphere);
 
-		LOCK_GUARD(datalock);
-		GET_SCOPED_CFG_AND_DGC();
+		GET_SCOPED_CFG();
 
-		dgc->geometry_pool.add_or_update_instance(
+		_add_instance(
 				scfg,
 				ConvertableInstanceType::CUBE,
 				duration,
@@ -876,10 +1272,9 @@ void DebugDraw3D::draw_box_xf(const Transform3D &transform, const Color &color,
 		sb.position = transform.origin + (transform.basis[0] + transform.basis[1] + transform.basis[2]) * 0.5f;
 	}
 
-	LOCK_GUARD(datalock);
-	GET_SCOPED_CFG_AND_DGC();
+	GET_SCOPED_CFG();
 
-	dgc->geometry_pool.add_or_update_instance(
+	_add_instance(
 			scfg,
 			is_box_centered ? ConvertableInstanceType::CUBE_CENTERED : ConvertableInstanceType::CUBE,
 			duration,
@@ -889,6 +1284,47 @@ void DebugDraw3D::draw_box_xf(const Transform3D &transform, const Color &color,
 			sb);
 }
 
+void DebugDraw3D::draw_boxes_xf(const PackedFloat32Array &transforms, const PackedColorArray &colors, const Color &color, const bool &is_box_centered, const real_t &duration) {
+	ZoneScoped;
+	CHECK_BEFORE_CALL();
+
+	const int64_t count = transforms.size() / 12;
+	ERR_FAIL_COND_MSG(transforms.size() % 12, "The number of floats in transforms must be a multiple of 12.");
+	if (!count) {
+		return;
+	}
+	ERR_FAIL_COND_MSG(colors.size() && colors.size() != count, "The number of colors must be 0 or equal to the number of boxes.");
+
+	GET_SCOPED_CFG();
+
+	const float *f = transforms.ptr();
+	const Color *cols = colors.size() ? colors.ptr() : nullptr;
+	const Color def_color = IS_DEFAULT_COLOR(color) ? Colors::forest_green : color;
+
+	_add_instances(
+			scfg,
+			(int)(is_box_centered ? ConvertableInstanceType::CUBE_CENTERED : ConvertableInstanceType::CUBE),
+			true,
+			duration,
+			GET_PROC_TYPE(),
+			count,
+			nullptr,
+			[&](Transform3D *r_transforms, Color *r_colors, SphereBounds *r_bounds) {
+				for (int64_t i = 0; i < count; i++) {
+					const float *x = f + i * 12;
+					Transform3D &t = r_transforms[i];
+					t = Transform3D(x[0], x[1], x[2], x[4], x[5], x[6], x[8], x[9], x[10], x[3], x[7], x[11]);
+					r_colors[i] = cols && !IS_DEFAULT_COLOR(cols[i]) ? cols[i] : def_color;
+
+					// Same as in draw_box_xf
+					r_bounds[i] = SphereBounds(t.origin, MathUtils::get_max_basis_length(t.basis) * MathUtils::CubeRadiusForSphere);
+					if (!is_box_centered) {
+						r_bounds[i].position = t.origin + (t.basis[0] + t.basis[1] + t.basis[2]) * 0.5f;
+					}
+				}
+			});
+}
+
 void DebugDraw3D::draw_aabb(const AABB &aabb, const Color &color, const real_t &duration) {
 	ZoneScoped;
 	CHECK_BEFORE_CALL();
@@ -913,14 +1349,13 @@ void DebugDraw3D::draw_line_hit(const Vector3 &start, const Vector3 &end, const
 	ZoneScoped;
 	CHECK_BEFORE_CALL();
 
-	LOCK_GUARD(datalock);
 	if (is_hit) {
-		add_or_update_line_with_thickness(duration, std::unique_ptr<Vector3[]>(new Vector3[2]{ start, hit }), 2, IS_DEFAULT_COLOR(hit_color) ? config->get_line_hit_color() : hit_color);
-		add_or_update_line_with_thickness(duration, std::unique_ptr<Vector3[]>(new Vector3[2]{ hit, end }), 2, IS_DEFAULT_COLOR(after_hit_color) ? config->get_line_after_hit_color() : after_hit_color);
+		add_or_update_line_with_thickness(duration, std::array<Vector3, 2>{ start, hit }.data(), 2, IS_DEFAULT_COLOR(hit_color) ? config->get_line_hit_color() : hit_color);
+		add_or_update_line_with_thickness(duration, std::array<Vector3, 2>{ hit, end }.data(), 2, IS_DEFAULT_COLOR(after_hit_color) ? config->get_line_after_hit_color() : after_hit_color);
 
-		GET_SCOPED_CFG_AND_DGC();
+		GET_SCOPED_CFG();
 
-		dgc->geometry_pool.add_or_update_instance(
+		_add_instance(
 				scfg,
 				InstanceType::BILLBOARD_SQUARE,
 				duration,
@@ -930,7 +1365,7 @@ void DebugDraw3D::draw_line_hit(const Vector3 &start, const Vector3 &end, const
 				SphereBounds(hit, MathUtils::CubeRadiusForSphere * hit_size),
 				&Colors::empty_color);
 	} else {
-		add_or_update_line_with_thickness(duration, std::unique_ptr<Vector3[]>(new Vector3[2]{ start, end }), 2, IS_DEFAULT_COLOR(hit_color) ? config->get_line_hit_color() : hit_color);
+		add_or_update_line_with_thickness(duration, std::array<Vector3, 2>{ start, end }.data(), 2, IS_DEFAULT_COLOR(hit_color) ? config->get_line_hit_color() : hit_color);
 	}
 }
 
@@ -951,7 +1386,7 @@ void DebugDraw3D::draw_line(const Vector3 &a, const Vector3 &b, const Color &col
 	ZoneScoped;
 	CHECK_BEFORE_CALL();
 
-	add_or_update_line_with_thickness(duration, std::unique_ptr<Vector3[]>(new Vector3[2]{ a, b }), 2, IS_DEFAULT_COLOR(color) ? Colors::red : color);
+	add_or_update_line_with_thickness(duration, std::array<Vector3, 2>{ a, b }.data(), 2, IS_DEFAULT_COLOR(color) ? Colors::red : color);
 }
 
 void DebugDraw3D::draw_lines(const PackedVector3Array &lines, const Color &color, const real_t &duration) {
@@ -963,11 +1398,7 @@ void DebugDraw3D::draw_lines(const PackedVector3Array &lines, const Color &color
 		return;
 	}
 
-	size_t s = lines.size();
-	std::unique_ptr<Vector3[]> l(new Vector3[s]);
-	memcpy(l.get(), lines.ptr(), s * sizeof(Vector3));
-
-	add_or_update_line_with_thickness(duration, std::move(l), s, IS_DEFAULT_COLOR(color) ? Colors::red : color);
+	add_or_update_line_with_thickness(duration, lines.ptr(), lines.size(), IS_DEFAULT_COLOR(color) ? Colors::red : color);
 }
 
 void DebugDraw3D::draw_lines_c(const std::vector<Vector3> &lines, const Color &color, const real_t &duration) {
@@ -979,18 +1410,14 @@ void DebugDraw3D::draw_lines_c(const std::vector<Vector3> &lines, const Color &c
 		return;
 	}
 
-	size_t s = lines.size();
-	std::unique_ptr<Vector3[]> l(new Vector3[s]);
-	memcpy(l.get(), lines.data(), s * sizeof(Vector3));
-
-	add_or_update_line_with_thickness(duration, std::move(l), s, IS_DEFAULT_COLOR(color) ? Colors::red : color);
+	add_or_update_line_with_thickness(duration, lines.data(), lines.size(), IS_DEFAULT_COLOR(color) ? Colors::red : color);
 }
 
 void DebugDraw3D::draw_ray(const Vector3 &origin, const Vector3 &direction, const real_t &length, const Color &color, const real_t &duration) {
 	ZoneScoped;
 	CHECK_BEFORE_CALL();
 
-	add_or_update_line_with_thickness(duration, std::unique_ptr<Vector3[]>(new Vector3[2]{ origin, origin + direction * length }), 2, IS_DEFAULT_COLOR(color) ? Colors::red : color);
+	add_or_update_line_with_thickness(duration, std::array<Vector3, 2>{ origin, origin + direction * length }.data(), 2, IS_DEFAULT_COLOR(color) ? Colors::red : color);
 }
 
 void DebugDraw3D::draw_line_path(const PackedVector3Array &path, const Color &color, const real_t &duration) {
@@ -1004,11 +1431,10 @@ void DebugDraw3D::draw_line_path(const PackedVector3Array &path, const Color &co
 		return;
 	}
 
-	size_t s = (path.size() - 1) * 2;
-	std::unique_ptr<Vector3[]> l(new Vector3[s]);
-	GeometryGenerator::CreateLinesFromPathWireframe(path, l.get());
+	std::vector<Vector3> l;
+	GeometryGenerator::CreateLinesFromPathWireframe(path, l);
 
-	add_or_update_line_with_thickness(duration, std::move(l), s, IS_DEFAULT_COLOR(color) ? Colors::light_green : color);
+	add_or_update_line_with_thickness(duration, l.data(), l.size(), IS_DEFAULT_COLOR(color) ? Colors::light_green : color);
 }
 
 #pragma endregion // Normal
@@ -1024,10 +1450,9 @@ void DebugDraw3D::create_arrow(const Vector3 &p_a, const Vector3 &p_b, const Col
 	Vector3 up = get_up_vector(dir);
 	Transform3D t = Transform3D(Basis().looking_at(dir, up).scaled(VEC3_ONE(size)), p_b);
 
-	GET_SCOPED_CFG_AND_DGC();
+	GET_SCOPED_CFG();
 
-	LOCK_GUARD(datalock);
-	dgc->geometry_pool.add_or_update_instance(
+	_add_instance(
 			scfg,
 			ConvertableInstanceType::ARROWHEAD,
 			p_duration,
@@ -1041,10 +1466,9 @@ void DebugDraw3D::draw_arrowhead(const Transform3D &transform, const Color &colo
 	ZoneScoped;
 	CHECK_BEFORE_CALL();
 
-	LOCK_GUARD(datalock);
-	GET_SCOPED_CFG_AND_DGC();
+	GET_SCOPED_CFG();
 
-	dgc->geometry_pool.add_or_update_instance(
+	_add_instance(
 			scfg,
 			ConvertableInstanceType::ARROWHEAD,
 			duration,
@@ -1058,8 +1482,7 @@ void DebugDraw3D::draw_arrow(const Vector3 &a, const Vector3 &b, const Color &co
 	ZoneScoped;
 	CHECK_BEFORE_CALL();
 
-	LOCK_GUARD(datalock);
-	add_or_update_line_with_thickness(duration, std::unique_ptr<Vector3[]>(new Vector3[2]{ a, b }), 2, IS_DEFAULT_COLOR(color) ? Colors::light_green : color);
+	add_or_update_line_with_thickness(duration, std::array<Vector3, 2>{ a, b }.data(), 2, IS_DEFAULT_COLOR(color) ? Colors::light_green : color);
 	create_arrow(a, b, color, arrow_size, is_absolute_size, duration);
 }
 
@@ -1073,12 +1496,10 @@ void DebugDraw3D::draw_arrow_path(const PackedVector3Array &path, const Color &c
 	ZoneScoped;
 	CHECK_BEFORE_CALL();
 
-	size_t s = (path.size() - 1) * 2;
-	std::unique_ptr<Vector3[]> l(new Vector3[s]);
-	GeometryGenerator::CreateLinesFromPathWireframe(path, l.get());
+	std::vector<Vector3> l;
+	GeometryGenerator::CreateLinesFromPathWireframe(path, l);
 
-	LOCK_GUARD(datalock);
-	add_or_update_line_with_thickness(duration, std::move(l), s, IS_DEFAULT_COLOR(color) ? Colors::light_green : color);
+	add_or_update_line_with_thickness(duration, l.data(), l.size(), IS_DEFAULT_COLOR(color) ? Colors::light_green : color);
 
 	for (int i = 0; i < path.size() - 1; i++) {
 		create_arrow(path[i], path[i + 1], color, arrow_size, is_absolute_size, duration);
@@ -1092,7 +1513,6 @@ void DebugDraw3D::draw_point_path(const PackedVector3Array &path, const PointTyp
 	ZoneScoped;
 	CHECK_BEFORE_CALL();
 
-	LOCK_GUARD(datalock);
 	draw_points(path, type, size, IS_DEFAULT_COLOR(points_color) ? Colors::red : points_color, duration);
 	draw_line_path(path, IS_DEFAULT_COLOR(lines_color) ? Colors::green : lines_color, duration);
 }
@@ -1108,10 +1528,9 @@ void DebugDraw3D::draw_square(const Vector3 &position, const real_t &size, const
 
 	Transform3D t(Basis().scaled(VEC3_ONE(size)), position);
 
-	LOCK_GUARD(datalock);
-	GET_SCOPED_CFG_AND_DGC();
+	GET_SCOPED_CFG();
 
-	dgc->geometry_pool.add_or_update_instance(
+	_add_instance(
 			scfg,
 			InstanceType::BILLBOARD_SQUARE,
 			duration,
@@ -1128,8 +1547,7 @@ void DebugDraw3D::draw_plane(const Plane &plane, const Color &color, const Vecto
 
 	Color front_color = IS_DEFAULT_COLOR(color) ? Colors::plane_light_sky_blue : color;
 
-	LOCK_GUARD(datalock);
-	GET_SCOPED_CFG_AND_DGC();
+	GET_SCOPED_CFG();
 
 	Camera3D *cam = scfg->dcd.viewport ? scfg->dcd.viewport->get_camera_3d() : nullptr;
 
@@ -1139,7 +1557,7 @@ void DebugDraw3D::draw_plane(const Plane &plane, const Color &color, const Vecto
 	t = t.looking_at(center_pos + plane.normal, get_up_vector(plane.normal)).scaled_local(VEC3_ONE(plane_size));
 	Color custom_col = Color::from_hsv(front_color.get_h(), Math::clamp(front_color.get_s() - 0.25f, 0.f, 1.f), Math::clamp(front_color.get_v() - 0.25f, 0.f, 1.f), front_color.a);
 
-	dgc->geometry_pool.add_or_update_instance(
+	_add_instance(
 			scfg,
 			InstanceType::PLANE,
 			duration,
@@ -1154,15 +1572,40 @@ void DebugDraw3D::draw_points(const PackedVector3Array &points, const PointType
 	ZoneScoped;
 	CHECK_BEFORE_CALL();
 
-	LOCK_GUARD(datalock);
-	for (int i = 0; i < points.size(); i++) {
-		switch (type) {
-			case PointType::POINT_TYPE_SQUARE:
-				draw_square(points[i], size, color, duration);
-				break;
-			case PointType::POINT_TYPE_SPHERE:
-				draw_sphere(points[i], size, color, duration);
-				break;
+	const int64_t count = points.size();
+	if (!count) {
+		return;
+	}
+
+	const Vector3 *p = points.ptr();
+	switch (type) {
+		case PointType::POINT_TYPE_SQUARE: {
+			GET_SCOPED_CFG();
+
+			const Color col = IS_DEFAULT_COLOR(color) ? Colors::red : color;
+			const real_t radius = MathUtils::CubeRadiusForSphere * size;
+
+			_add_instances(
+					scfg,
+					(int)InstanceType::BILLBOARD_SQUARE,
+					false,
+					duration,
+					GET_PROC_TYPE(),
+					count,
+					&Colors::empty_color,
+					[&](Transform3D *r_transforms, Color *r_colors, SphereBounds *r_bounds) {
+						for (int64_t i = 0; i < count; i++) {
+							r_transforms[i] = Transform3D(size, 0, 0, 0, size, 0, 0, 0, size, p[i].x, p[i].y, p[i].z);
+							r_colors[i] = col;
+							r_bounds[i] = SphereBounds(p[i], radius);
+						}
+					});
+			break;
+		}
+		case PointType::POINT_TYPE_SPHERE: {
+			const float radius = (float)size;
+			_draw_spheres(p, count, &radius, 0, nullptr, color, duration);
+			break;
 		}
 	}
 }
@@ -1171,10 +1614,9 @@ void DebugDraw3D::draw_position(const Transform3D &transform, const Color &color
 	ZoneScoped;
 	CHECK_BEFORE_CALL();
 
-	LOCK_GUARD(datalock);
-	GET_SCOPED_CFG_AND_DGC();
+	GET_SCOPED_CFG();
 
-	dgc->geometry_pool.add_or_update_instance(
+	_add_instance(
 			scfg,
 			ConvertableInstanceType::POSITION,
 			duration,
@@ -1193,7 +1635,6 @@ void DebugDraw3D::draw_gizmo(const Transform3D &transform, const Color &color, c
 #define MINUS(axis) transform.origin - transform.basis.get_column(axis)
 #define PLUS(axis) transform.origin + transform.basis.get_column(axis)
 
-	LOCK_GUARD(datalock);
 	if (is_centered) {
 		draw_arrow(MINUS(0 /** 0.5f*/), PLUS(0 /** 0.5f*/), COLOR(x), 0.1f, true, duration);
 		draw_arrow(MINUS(1 /** 0.5f*/), PLUS(1 /** 0.5f*/), COLOR(y), 0.1f, true, duration);
@@ -1238,6 +1679,7 @@ void DebugDraw3D::draw_grid_xf(const Transform3D &transform, const Vector2i &p_s
 							 transform.origin;
 
 	std::vector<Vector3> lines;
+	lines.reserve(((size_t)subdivision.x + 1 + subdivision.y + 1) * 2);
 	for (int x = 0; x < subdivision.x + 1; x++) {
 		lines.push_back(origin + x_d * (real_t)x);
 		lines.push_back(origin + x_d * (real_t)x + z_axis);
@@ -1257,19 +1699,17 @@ void DebugDraw3D::draw_camera_frustum_planes_c(const std::array<Plane, 6> &plane
 	ZoneScoped;
 	CHECK_BEFORE_CALL();
 
-	size_t s = GeometryGenerator::CubeIndexes.size();
-	std::unique_ptr<Vector3[]> l(new Vector3[s]);
-	GeometryGenerator::CreateCameraFrustumLinesWireframe(planes, l.get());
+	std::array<Vector3, GeometryGenerator::CubeIndexes.size()> l;
+	GeometryGenerator::CreateCameraFrustumLinesWireframe(planes, l.data());
 
-	LOCK_GUARD(datalock);
-	add_or_update_line_with_thickness(duration, std::move(l), s, IS_DEFAULT_COLOR(color) ? Colors::red : color);
+	add_or_update_line_with_thickness(duration, l.data(), l.size(), IS_DEFAULT_COLOR(color) ? Colors::red : color);
 }
 
 void DebugDraw3D::draw_camera_frustum(const Camera3D *camera, const Color &color, const real_t &duration) {
 	ZoneScoped;
 	CHECK_BEFORE_CALL();
 	ERR_FAIL_COND(!camera);
-	draw_camera_frustum_planes(camera->get_frustum(), color, duration);
+	draw_camera_frustum_planes_c(MathUtils::get_projection_planes(_get_camera_projection(camera), camera->get_camera_transform()), color, duration);
 }
 
 void DebugDraw3D::draw_camera_frustum_planes(const Array &camera_frustum, const Color &color, const real_t &duration) {
@@ -1297,4 +1737,4 @@ void DebugDraw3D::draw_camera_frustum_planes(const Array &camera_frustum, const
 #undef GET_PROC_TYPE
 #undef CHECK_BEFORE_CALL
 #undef NEED_LEAVE
-#undef GET_SCOPED_CFG_AND_DGC
+#undef GET_SCOPED_CFG
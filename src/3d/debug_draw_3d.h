@@ -1,11 +1,14 @@
 #pragma once
 
 #include "common/colors.h"
+#include "batch_scope_3d.h"
 #include "common/i_scope_storage.h"
 #include "config_scope_3d.h"
+#include "draw_commands.h"
 #include "render_instances_enums.h"
 #include "utils/profiler.h"
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -27,7 +30,7 @@ class DebugDraw3DStats;
 
 #ifndef DISABLE_DEBUG_RENDERING
 class DebugGeometryContainer;
-struct DelayedRendererLine;
+class GeometryPoolCullingData;
 #endif
 
 /// @private
@@ -36,6 +39,7 @@ enum class MeshMaterialType : char {
 	Billboard,
 	Plane,
 	Extendable,
+	ExtendableLine,
 	MAX,
 };
 
@@ -93,6 +97,7 @@ public:
  * ---
  * @note
  * You can use this class anywhere, including in `_physics_process` and `_process` (and probably from other threads).
+ * Draw calls from each thread are recorded without a global lock and are added to the scene at the start of the next process or physics tick.
  * It is worth mentioning that physics ticks may not be called every frame or may be called several times in one frame.
  * So if you want to avoid multiple identical `draw_` calls, you can call `draw_` methods in `_process` or use such a check:
  * ```python
@@ -158,30 +163,60 @@ private:
 #ifndef DISABLE_DEBUG_RENDERING
 	ProfiledMutex(std::recursive_mutex, datalock, "3D Geometry lock");
 
-	typedef std::pair<uint64_t, DebugDraw3DScopeConfig *> ScopedPairIdConfig;
-	// stores thread id and array of id's with ptrs
-	std::unordered_map<uint64_t, std::vector<ScopedPairIdConfig> > scoped_configs;
-	// stores thread id and most recent config
-	std::unordered_map<uint64_t, std::shared_ptr<DebugDraw3DScopeConfig::Data> > cached_scoped_configs;
-	uint64_t created_scoped_configs = 0;
+	typedef std::pair<uint64_t, std::shared_ptr<DebugDraw3DScopeConfig::Data> > ScopedPairIdConfig;
+	/// Stack of scoped configs of a thread. It is stored in `thread_local` storage.
+	struct ThreadScopedConfigs {
+		uint64_t owner_id = 0;
+		uint64_t epoch = 0;
+		uint64_t thread_id = 0;
+		std::vector<ScopedPairIdConfig> stack;
+	};
+	// The stacks of all threads are reset on the next access when the epoch changes
+	std::atomic<uint64_t> scoped_configs_epoch = 1;
+	std::atomic<int64_t> registered_scoped_configs = 0;
+	std::atomic<uint64_t> created_scoped_configs = 0;
+	// Configs unregistered from other threads. They are removed by their threads on the next access.
+	std::mutex foreign_unregisters_mutex;
+	std::unordered_map<uint64_t, std::vector<uint64_t> > foreign_unregisters;
+	std::atomic<uint64_t> foreign_unregisters_count = 0;
 	struct {
 		uint64_t created;
 		uint64_t orphans;
 	} scoped_stats_3d = {};
 
 	// Inherited via IScopeStorage
-	const std::shared_ptr<DebugDraw3DScopeConfig::Data> scoped_config_for_current_thread() override;
+	DebugDraw3DScopeConfig::Data *scoped_config_for_current_thread() override;
+	ThreadScopedConfigs &_get_thread_scoped_configs();
+	void _apply_foreign_unregisters(ThreadScopedConfigs &p_cfgs);
+	void _remove_scoped_config(ThreadScopedConfigs &p_cfgs, const uint64_t &p_guard_id);
+
+	/// Batch opened by `begin_batch` in a thread. It is stored in `thread_local` storage.
+	/// The values resolved at the beginning of the batch are used until the scoped configs are cleared at the end of the frame.
+	struct ThreadBatch {
+		const DebugDraw3D *owner = nullptr;
+		uint64_t epoch = 0;
+		uint32_t depth = 0;
+		ProcessType proc = ProcessType::PROCESS;
+		ThreadScopedConfigs *scoped_configs = nullptr;
+		ThreadDrawCommands *commands = nullptr;
+	};
+	ThreadBatch &_get_thread_batch();
+	/// Returns the batch of the current thread or nullptr
+	ThreadBatch *_get_active_batch();
+	_FORCE_INLINE_ DebugDraw3DScopeConfig::Data *_get_batch_scoped_config(ThreadBatch *p_batch);
 
 	// Meshes
 	/// Store meshes shared between many debug containers
 	std::vector<std::array<Ref<ArrayMesh>, 2> > shared_generated_meshes;
 	/// Store World3D id and debug container
-	std::unordered_map<uint64_t, std::shared_ptr<DebugGeometryContainer>[2]> debug_containers;
+	std::unordered_map<uint64_t, std::shared_ptr<DebugGeometryContainer> > debug_containers;
 	struct viewportToWorldCache {
 		uint64_t world_id = 0;
-		std::shared_ptr<DebugGeometryContainer> dgcs[2];
+		std::shared_ptr<DebugGeometryContainer> dgc;
 	};
 	std::unordered_map<const Viewport *, viewportToWorldCache> viewport_to_world_cache;
+	/// Culling data of each viewport shared by all containers in the current frame
+	std::unordered_map<Viewport *, std::shared_ptr<GeometryPoolCullingData> > frame_culling_data;
 
 	// Default materials and shaders
 	Ref<ShaderMaterial> mesh_shaders[(int)MeshMaterialType::MAX][(int)MeshMaterialVariant::MAX];
@@ -192,14 +227,46 @@ private:
 	void _clear_scoped_configs() override;
 
 	std::array<Ref<ArrayMesh>, 2> *get_shared_meshes();
-	std::shared_ptr<DebugGeometryContainer> create_debug_container(bool p_no_depth_test);
+	std::shared_ptr<DebugGeometryContainer> create_debug_container();
 	std::shared_ptr<DebugGeometryContainer> get_debug_container(const DebugDraw3DScopeConfig::DebugContainerDependent &p_dgcd, const bool p_generate_new_container);
 	void _register_viewport_world_deferred(uint64_t /*Viewport * */ p_vp, const uint64_t p_world_id);
+#ifdef DEBUG_ENABLED
+	/// Returns `[cylinder transforms, endpoint transforms]` of pairs of points. Used to test MathUtils from scripts.
+	Array _get_segment_transforms(const PackedVector3Array &p_lines, const PackedFloat32Array &p_radii);
+#endif
 	Viewport *_get_root_world_viewport(Viewport *p_vp);
 	void _remove_debug_container(const uint64_t &p_world_id);
+	/// Returns the frustums and cameras of the viewport. They are calculated once per frame.
+	std::shared_ptr<GeometryPoolCullingData> _get_culling_data(Viewport *p_vp);
+
+	// Draw calls of each thread. The mutex is used only to register a new thread and to merge the commands.
+	// The commands of the exited threads are removed after the last merge.
+	std::mutex thread_draw_commands_mutex;
+	std::vector<std::shared_ptr<ThreadDrawCommands> > thread_draw_commands;
+
+	ThreadDrawCommands *_get_thread_draw_commands();
+	/// Adds the recorded commands of all threads to the containers or discards them
+	void _flush_draw_commands(const bool &p_discard = false);
+	void _add_instance(DebugDraw3DScopeConfig::Data *p_cfg, ConvertableInstanceType p_type, const real_t &p_exp_time, const ProcessType &p_proc, const Transform3D &p_transform, const Color &p_col, const SphereBounds &p_bounds, const Color *p_custom_col = nullptr);
+	void _add_instance(DebugDraw3DScopeConfig::Data *p_cfg, InstanceType p_type, const real_t &p_exp_time, const ProcessType &p_proc, const Transform3D &p_transform, const Color &p_col, const SphereBounds &p_bounds, const Color *p_custom_col = nullptr);
+	void _add_lines(DebugDraw3DScopeConfig::Data *p_cfg, const real_t &p_exp_time, const ProcessType &p_proc, const Vector3 *p_lines, const size_t p_line_count, const Color &p_col);
+
+	/// Records `p_count` instances of the same type at once.
+	/// `p_fill(r_transforms, r_colors, r_bounds)` must fill `p_count` elements of the arrays. It is called while the commands are locked for writing.
+	template <class TFill>
+	void _add_instances(DebugDraw3DScopeConfig::Data *p_cfg, const int &p_type, const bool &p_is_convertable_type, const real_t &p_exp_time, const ProcessType &p_proc, const size_t &p_count, const Color *p_custom_col, const TFill &p_fill) {
+		ThreadDrawCommands *tc = _get_thread_draw_commands();
+		DrawCommands *cmds = tc->begin_write();
+		size_t offset = cmds->add_instances(p_cfg, p_type, p_is_convertable_type, p_exp_time, p_proc, p_count, p_custom_col);
+
+		p_fill(cmds->batch_transforms.data() + offset, cmds->batch_colors.data() + offset, cmds->batch_bounds.data() + offset);
+		tc->end_write(cmds);
+	}
+
+	void _draw_spheres(const Vector3 *p_positions, const size_t &p_count, const float *p_radii, const size_t &p_radii_step, const Color *p_colors, const Color &p_color, const real_t &p_duration);
 
 	_FORCE_INLINE_ Vector3 get_up_vector(const Vector3 &p_dir);
-	void add_or_update_line_with_thickness(real_t p_exp_time, std::unique_ptr<Vector3[]> p_lines, const size_t p_line_count, const Color &p_col, const std::function<void(DelayedRendererLine *)> p_custom_upd = nullptr);
+	void add_or_update_line_with_thickness(real_t p_exp_time, const Vector3 *p_lines, const size_t p_line_count, const Color &p_col);
 	Node *get_root_node();
 
 	void create_arrow(const Vector3 &p_a, const Vector3 &p_b, const Color &p_color, const real_t &p_arrow_size, const bool &p_is_absolute_size, const real_t &p_duration = 0);
@@ -260,6 +327,27 @@ public:
 	 */
 	Ref<DebugDraw3DScopeConfig> scoped_config() override;
 
+	/**
+	 * Start a batch of `draw_*` calls in the current thread.
+	 *
+	 * Inside the batch, the process type and the storage of the current thread are resolved only once,
+	 * which makes loops of scalar calls cheaper. Scoped configs created inside the batch are still applied.
+	 *
+	 * Each call must be paired with DebugDraw3D.end_batch in the same thread. Batches can be nested.
+	 * An unfinished batch is dropped at the end of the frame.
+	 */
+	void begin_batch();
+	/**
+	 * End the batch started by DebugDraw3D.begin_batch.
+	 */
+	void end_batch();
+	/**
+	 * Start a batch as in DebugDraw3D.begin_batch and return DebugDraw3DBatchScope, which ends the batch when it is deleted.
+	 *
+	 * Store this instance in a local variable inside the method.
+	 */
+	Ref<DebugDraw3DBatchScope> new_batch_scope();
+
 	/**
 	 * Set the configuration global for everything in DebugDraw3D.
 	 */
@@ -348,6 +436,17 @@ public:
 	 */
 	void draw_sphere_xf(const Transform3D &transform, const Color &color = Colors::empty_color, const real_t &duration = 0) FAKE_FUNC_IMPL;
 
+	/**
+	 * Draw many spheres at once. This is much faster than calling DebugDraw3D.draw_sphere for each of them.
+	 *
+	 * @param positions Centers of the spheres
+	 * @param radii Radii of the spheres. A single value is used for all spheres
+	 * @param colors Colors of the spheres. If empty or a color is DebugDraw3D.empty_color, then `color` is used
+	 * @param color Primary color
+	 * @param duration The duration of how long the objects will be visible
+	 */
+	void draw_spheres(const PackedVector3Array &positions, const PackedFloat32Array &radii, const PackedColorArray &colors = PackedColorArray(), const Color &color = Colors::empty_color, const real_t &duration = 0) FAKE_FUNC_IMPL;
+
 #pragma endregion // Spheres
 
 #pragma region Cylinders
@@ -376,6 +475,17 @@ public:
 	 */
 	void draw_cylinder_ab(const Vector3 &a, const Vector3 &b, const real_t &radius = 0.5f, const Color &color = Colors::empty_color, const real_t &duration = 0) FAKE_FUNC_IMPL;
 
+	/**
+	 * Draw many cylinders as in DebugDraw3D.draw_cylinder_ab at once
+	 *
+	 * @param points Pairs of the bottom and top points of the cylinders
+	 * @param radii Radii of the cylinders. A single value is used for all cylinders
+	 * @param colors Colors of the cylinders. If empty or a color is DebugDraw3D.empty_color, then `color` is used
+	 * @param color Primary color
+	 * @param duration The duration of how long the objects will be visible
+	 */
+	void draw_cylinders_ab(const PackedVector3Array &points, const PackedFloat32Array &radii, const PackedColorArray &colors = PackedColorArray(), const Color &color = Colors::empty_color, const real_t &duration = 0) FAKE_FUNC_IMPL;
+
 #pragma endregion // Cylinders
 
 #pragma region Boxes
@@ -422,6 +532,18 @@ public:
 	 */
 	void draw_box_xf(const Transform3D &transform, const Color &color = Colors::empty_color, const bool &is_box_centered = true, const real_t &duration = 0) FAKE_FUNC_IMPL;
 
+	/**
+	 * Draw many boxes as in DebugDraw3D.draw_box_xf at once
+	 *
+	 * @param transforms 12 floats for each box in the same layout as in MultiMesh.buffer:
+	 * `basis.x.x, basis.y.x, basis.z.x, origin.x, basis.x.y, basis.y.y, basis.z.y, origin.y, basis.x.z, basis.y.z, basis.z.z, origin.z`
+	 * @param colors Colors of the boxes. If empty or a color is DebugDraw3D.empty_color, then `color` is used
+	 * @param color Primary color
+	 * @param is_box_centered Set where the center of the boxes will be. In the center or in the bottom corner
+	 * @param duration The duration of how long the objects will be visible
+	 */
+	void draw_boxes_xf(const PackedFloat32Array &transforms, const PackedColorArray &colors = PackedColorArray(), const Color &color = Colors::empty_color, const bool &is_box_centered = true, const real_t &duration = 0) FAKE_FUNC_IMPL;
+
 	/**
 	 * Draw a box as in DebugDraw3D.draw_box, but based on the AABB
 	 *
@@ -10,19 +10,36 @@
 #include <array>
 
 GODOT_WARNING_DISABLE()
-#include <godot_cpp/classes/camera3d.hpp>
 #include <godot_cpp/classes/mesh.hpp>
 #include <godot_cpp/classes/world3d.hpp>
 GODOT_WARNING_RESTORE()
 using namespace godot;
 
-DebugGeometryContainer::DebugGeometryContainer(class DebugDraw3D *p_root, bool p_no_depth_test) {
+DebugGeometryContainer::DebugGeometryContainer(class DebugDraw3D *p_root) {
 	ZoneScoped;
-	DEV_PRINT_STD("New " NAMEOF(DebugGeometryContainer) " created: %s\n", p_no_depth_test ? "NoDepth" : "Normal");
+	DEV_PRINT_STD("New " NAMEOF(DebugGeometryContainer) " created\n");
 	owner = p_root;
+
+	// The instances without the depth test are created only when they are used
+	_create_render_instances(DepthTestMode::NORMAL);
+}
+
+DebugGeometryContainer::~DebugGeometryContainer() {
+	ZoneScoped;
+	DEV_PRINT_STD(NAMEOF(DebugGeometryContainer) " destroyed: World3D (%d)\n", base_world_viewport.is_valid() ? base_world_viewport->get_instance_id() : 0);
+	LOCK_GUARD(owner->datalock);
+
+	geometry_pool.clear_pool();
+}
+
+void DebugGeometryContainer::_create_render_instances(const DepthTestMode &p_depth) {
+	ZoneScoped;
+	RenderInstances &ri = render_instances[(int)p_depth];
+	if (ri.is_created) {
+		return;
+	}
+	DEV_PRINT_STD("Creating %s render instances of " NAMEOF(DebugGeometryContainer) "\n", p_depth == DepthTestMode::NO_DEPTH ? "NoDepth" : "Normal");
 	RenderingServer *rs = RenderingServer::get_singleton();
-	no_depth_test = p_no_depth_test;
-	geometry_pool.set_no_depth_test_info(no_depth_test);
 
 	// Create wireframe mesh drawer
 	{
@@ -35,85 +52,45 @@ DebugGeometryContainer::DebugGeometryContainer(class DebugDraw3D *p_root, bool p
 		rs->instance_geometry_set_flag(_immediate_instance, RenderingServer::INSTANCE_FLAG_USE_DYNAMIC_GI, false);
 		rs->instance_geometry_set_flag(_immediate_instance, RenderingServer::INSTANCE_FLAG_USE_BAKED_LIGHT, false);
 
-		Ref<ShaderMaterial> mat = owner->get_material_variant(MeshMaterialType::Wireframe, no_depth_test ? MeshMaterialVariant::NoDepth : MeshMaterialVariant::Normal);
+		Ref<ShaderMaterial> mat = owner->get_material_variant(MeshMaterialType::Wireframe, p_depth == DepthTestMode::NO_DEPTH ? MeshMaterialVariant::NoDepth : MeshMaterialVariant::Normal);
 		rs->instance_geometry_set_material_override(_immediate_instance, mat->get_rid());
 
-		immediate_mesh_storage.instance = _immediate_instance;
-		immediate_mesh_storage.material = mat;
-		immediate_mesh_storage.mesh = _array_mesh;
+		ri.immediate_mesh_storage.instance = _immediate_instance;
+		ri.immediate_mesh_storage.material = mat;
+		ri.immediate_mesh_storage.mesh = _array_mesh;
 	}
 
-	// Generate geometry and create MMI's in RenderingServer
-	{
-		auto *meshes = owner->get_shared_meshes();
-		int mat_variant = !!no_depth_test;
-
-		CreateMMI(InstanceType::CUBE, meshes[(int)InstanceType::CUBE][mat_variant]);
-		CreateMMI(InstanceType::CUBE_CENTERED, meshes[(int)InstanceType::CUBE_CENTERED][mat_variant]);
-		CreateMMI(InstanceType::ARROWHEAD, meshes[(int)InstanceType::ARROWHEAD][mat_variant]);
-		CreateMMI(InstanceType::POSITION, meshes[(int)InstanceType::POSITION][mat_variant]);
-		CreateMMI(InstanceType::SPHERE, meshes[(int)InstanceType::SPHERE][mat_variant]);
-		CreateMMI(InstanceType::SPHERE_HD, meshes[(int)InstanceType::SPHERE_HD][mat_variant]);
-		CreateMMI(InstanceType::CYLINDER, meshes[(int)InstanceType::CYLINDER][mat_variant]);
-		CreateMMI(InstanceType::CYLINDER_AB, meshes[(int)InstanceType::CYLINDER_AB][mat_variant]);
-
-		// VOLUMETRIC
-
-		CreateMMI(InstanceType::LINE_VOLUMETRIC, meshes[(int)InstanceType::LINE_VOLUMETRIC][mat_variant]);
-		CreateMMI(InstanceType::CUBE_VOLUMETRIC, meshes[(int)InstanceType::CUBE_VOLUMETRIC][mat_variant]);
-		CreateMMI(InstanceType::CUBE_CENTERED_VOLUMETRIC, meshes[(int)InstanceType::CUBE_CENTERED_VOLUMETRIC][mat_variant]);
-		CreateMMI(InstanceType::ARROWHEAD_VOLUMETRIC, meshes[(int)InstanceType::ARROWHEAD_VOLUMETRIC][mat_variant]);
-		CreateMMI(InstanceType::POSITION_VOLUMETRIC, meshes[(int)InstanceType::POSITION_VOLUMETRIC][mat_variant]);
-		CreateMMI(InstanceType::SPHERE_VOLUMETRIC, meshes[(int)InstanceType::SPHERE_VOLUMETRIC][mat_variant]);
-		CreateMMI(InstanceType::SPHERE_HD_VOLUMETRIC, meshes[(int)InstanceType::SPHERE_HD_VOLUMETRIC][mat_variant]);
-		CreateMMI(InstanceType::CYLINDER_VOLUMETRIC, meshes[(int)InstanceType::CYLINDER_VOLUMETRIC][mat_variant]);
-		CreateMMI(InstanceType::CYLINDER_AB_VOLUMETRIC, meshes[(int)InstanceType::CYLINDER_AB_VOLUMETRIC][mat_variant]);
-
-		// SOLID
-
-		CreateMMI(InstanceType::BILLBOARD_SQUARE, meshes[(int)InstanceType::BILLBOARD_SQUARE][mat_variant]);
-		CreateMMI(InstanceType::PLANE, meshes[(int)InstanceType::PLANE][mat_variant]);
-
-		set_render_layer_mask(1);
-	}
-}
-
-DebugGeometryContainer::~DebugGeometryContainer() {
-	ZoneScoped;
-	DEV_PRINT_STD(NAMEOF(DebugGeometryContainer) " destroyed: %s, World3D (%d)\n", no_depth_test ? "NoDepth" : "Normal", base_world_viewport.is_valid() ? base_world_viewport->get_instance_id() : 0);
-	LOCK_GUARD(owner->datalock);
-
-	geometry_pool.clear_pool();
-}
+	rs->instance_set_scenario(ri.immediate_mesh_storage.instance, base_world_viewport.is_valid() ? base_world_viewport->get_scenario() : RID());
+	rs->instance_set_layer_mask(ri.immediate_mesh_storage.instance, render_layers);
 
-bool DebugGeometryContainer::is_no_depth_test() const {
-	return no_depth_test;
+	ri.is_created = true;
 }
 
-void DebugGeometryContainer::CreateMMI(InstanceType p_type, Ref<ArrayMesh> p_mesh) {
+void DebugGeometryContainer::CreateMMI(RenderInstances &p_instances, const DepthTestMode &p_depth, InstanceType p_type) {
 	ZoneScoped;
+	DEV_PRINT_STD("Creating MultiMesh of type %d for %s depth test\n", (int)p_type, p_depth == DepthTestMode::NO_DEPTH ? "NoDepth" : "Normal");
 	RenderingServer *rs = RenderingServer::get_singleton();
+	Ref<ArrayMesh> mesh = owner->get_shared_meshes()[(int)p_type][(int)p_depth];
 
 	RID mmi = rs->instance_create();
 
-	Ref<MultiMesh> new_mm;
-	new_mm.instantiate();
-	new_mm->set_name(String::num_int64((int)p_type));
+	// The MultiMesh is used through the RenderingServer to avoid the calls of the MultiMesh resource
+	RID new_mm = rs->multimesh_create();
+	rs->multimesh_allocate_data(new_mm, 0, RenderingServer::MULTIMESH_TRANSFORM_3D, true, true);
+	rs->multimesh_set_mesh(new_mm, mesh->get_rid());
 
-	new_mm->set_transform_format(MultiMesh::TransformFormat::TRANSFORM_3D);
-	new_mm->set_use_colors(true);
-	new_mm->set_transform_format(MultiMesh::TRANSFORM_3D);
-	new_mm->set_use_custom_data(true);
-	new_mm->set_mesh(p_mesh);
-
-	rs->instance_set_base(mmi, new_mm->get_rid());
+	rs->instance_set_base(mmi, new_mm);
 
 	rs->instance_geometry_set_cast_shadows_setting(mmi, RenderingServer::SHADOW_CASTING_SETTING_OFF);
 	rs->instance_geometry_set_flag(mmi, RenderingServer::INSTANCE_FLAG_USE_DYNAMIC_GI, false);
 	rs->instance_geometry_set_flag(mmi, RenderingServer::INSTANCE_FLAG_USE_BAKED_LIGHT, false);
+	rs->instance_set_scenario(mmi, base_world_viewport.is_valid() ? base_world_viewport->get_scenario() : RID());
+	rs->instance_set_layer_mask(mmi, render_layers);
 
-	multi_mesh_storage[(int)p_type].instance = mmi;
-	multi_mesh_storage[(int)p_type].mesh = new_mm;
+	MultiMeshStorage &s = p_instances.multi_mesh_storage[(int)p_type];
+	s.instance = mmi;
+	s.mesh.multimesh = new_mm;
+	s.base_mesh = mesh;
 }
 
 void DebugGeometryContainer::set_world(Ref<World3D> p_new_world) {
@@ -126,10 +103,18 @@ void DebugGeometryContainer::set_world(Ref<World3D> p_new_world) {
 	RenderingServer *rs = RenderingServer::get_singleton();
 	RID scenario = base_world_viewport.is_valid() ? base_world_viewport->get_scenario() : RID();
 
-	for (auto &s : multi_mesh_storage) {
-		rs->instance_set_scenario(s.instance, scenario);
+	for (auto &ri : render_instances) {
+		if (!ri.is_created) {
+			continue;
+		}
+
+		for (auto &s : ri.multi_mesh_storage) {
+			if (s.is_created()) {
+				rs->instance_set_scenario(s.instance, scenario);
+			}
+		}
+		rs->instance_set_scenario(ri.immediate_mesh_storage.instance, scenario);
 	}
-	rs->instance_set_scenario(immediate_mesh_storage.instance, scenario);
 }
 
 Ref<World3D> DebugGeometryContainer::get_world() {
@@ -146,24 +131,44 @@ void DebugGeometryContainer::update_geometry(double p_delta) {
 	// accumulate a time delta to delete objects in any case after their timers expire.
 	geometry_pool.update_expiration_delta(p_delta, ProcessType::PROCESS);
 
+	{
+		const auto &cfg = owner->get_config();
+		GeometryPoolLimits limits;
+		limits.max_instances_per_type = (size_t)cfg->get_max_instances_per_type();
+		limits.max_lines = (size_t)cfg->get_max_lines();
+		limits.max_bytes = (size_t)cfg->get_max_memory_bytes();
+		limits.eviction_policy = (EvictionPolicy)cfg->get_eviction_policy();
+		geometry_pool.set_limits(limits);
+		geometry_pool.set_deduplication(cfg->is_use_deduplication());
+	}
+
 	// Do not update geometry if frozen
 	if (owner->get_config()->is_freeze_3d_render())
 		return;
 
-	if (immediate_mesh_storage.mesh->get_surface_count()) {
-		ZoneScopedN("Clear lines");
-		immediate_mesh_storage.mesh->clear_surfaces();
-	}
-
 	// Return if nothing to do
 	if (!owner->is_debug_enabled()) {
 		ZoneScopedN("Reset instances");
-		for (auto &item : multi_mesh_storage) {
-			if (item.mesh->get_visible_instance_count())
-				item.mesh->set_visible_instance_count(0);
+		for (auto &ri : render_instances) {
+			if (!ri.is_created) {
+				continue;
+			}
+
+			for (auto &item : ri.multi_mesh_storage) {
+				if (item.is_created() && item.mesh.visible_count != 0) {
+					RenderingServer::get_singleton()->multimesh_set_visible_instances(item.mesh.multimesh, 0);
+					item.mesh.visible_count = 0;
+				}
+			}
+			// The lines surface is persistent and will be recreated by the GeometryPool
+			if (ri.immediate_mesh_storage.mesh->get_surface_count()) {
+				ri.immediate_mesh_storage.mesh->clear_surfaces();
+			}
 		}
 		geometry_pool.reset_counter(p_delta);
 		geometry_pool.reset_visible_objects();
+		geometry_pool.reset_lines_surfaces();
+		geometry_pool.force_next_fill();
 		return;
 	}
 
@@ -172,86 +177,10 @@ void DebugGeometryContainer::update_geometry(double p_delta) {
 		set_render_layer_mask(owner->get_config()->get_geometry_render_layers());
 	}
 
+	// The culling data of each viewport is calculated once per frame
 	std::unordered_map<Viewport *, std::shared_ptr<GeometryPoolCullingData> > culling_data;
-	{
-		ZoneScopedN("Get frustums");
-
-		for (const auto &vp_p : available_viewports) {
-			std::vector<std::array<Plane, 6> > frustum_planes;
-			std::vector<AABBMinMax> frustum_boxes;
-
-			std::vector<std::pair<Array, Camera3D *> > frustum_arrays;
-			frustum_arrays.reserve(1);
-
-#ifdef DEBUG_ENABLED
-			auto custom_editor_viewports = owner->get_custom_editor_viewports();
-			bool is_editor_vp = std::find_if(
-										custom_editor_viewports.cbegin(),
-										custom_editor_viewports.cend(),
-										[&vp_p](const auto &it) { return it == vp_p; }) != custom_editor_viewports.cend();
-
-			if (IS_EDITOR_HINT() && is_editor_vp) {
-				Camera3D *cam = nullptr;
-				Node *root = SCENE_TREE()->get_edited_scene_root();
-				if (root) {
-					cam = root->get_viewport()->get_camera_3d();
-				}
-
-				if (owner->config->is_force_use_camera_from_scene() && cam) {
-					frustum_arrays.push_back({ cam->get_frustum(), cam });
-				} else if (custom_editor_viewports.size() > 0) {
-					for (const auto &evp : custom_editor_viewports) {
-						if (evp->get_update_mode() == SubViewport::UpdateMode::UPDATE_ALWAYS) {
-							Camera3D *cam = evp->get_camera_3d();
-							if (cam) {
-								frustum_arrays.push_back({ cam->get_frustum(), cam });
-							}
-						}
-					}
-				}
-			} else {
-#endif
-				Camera3D *vp_cam = vp_p->get_camera_3d();
-				if (vp_cam) {
-					frustum_arrays.push_back({ vp_cam->get_frustum(), vp_cam });
-				}
-#ifdef DEBUG_ENABLED
-			}
-#endif
-
-			// Convert Array to vector
-			if (frustum_arrays.size()) {
-				for (auto &pair : frustum_arrays) {
-					Array &arr = pair.first;
-					if (arr.size() == 6) {
-						std::array<Plane, 6> a;
-						for (int i = 0; i < arr.size(); i++)
-							a[i] = (Plane)arr[i];
-
-						MathUtils::scale_frustum_far_plane_distance(a, pair.second->get_global_transform(), owner->get_config()->get_frustum_length_scale());
-
-						if (owner->get_config()->is_use_frustum_culling())
-							frustum_planes.push_back(a);
-
-						auto cube = MathUtils::get_frustum_cube(a);
-						AABB aabb = MathUtils::calculate_vertex_bounds(cube.data(), cube.size());
-						frustum_boxes.push_back(aabb);
-
-#if false
-						// Debug camera bounds
-						{
-							SphereBounds sb = aabb;
-							auto cfg = owner->new_scoped_config()->set_thickness(0.1f)->set_hd_sphere(true); //->set_viewport(vp_p);
-							owner->draw_sphere(sb.position, sb.radius, Colors::crimson);
-							owner->draw_aabb(aabb, Colors::yellow);
-						}
-#endif
-					}
-				}
-			}
-
-			culling_data[vp_p] = std::make_shared<GeometryPoolCullingData>(frustum_planes, frustum_boxes);
-		}
+	for (const auto &vp_p : available_viewports) {
+		culling_data[vp_p] = owner->_get_culling_data(vp_p);
 	}
 
 	// Debug bounds of instances and lines
@@ -265,19 +194,19 @@ void DebugGeometryContainer::update_geometry(double p_delta) {
 		Viewport *vp;
 		if (available_viewports.size()) {
 			vp = *available_viewports.begin();
-			auto cfg = std::make_shared<DebugDraw3DScopeConfig::Data>(owner->scoped_config()->data);
+			auto cfg = std::make_shared<DebugDraw3DScopeConfig::Data>(owner->scoped_config()->data.get());
 			cfg->thickness = 0;
 
 			std::vector<AABBMinMax> new_instances;
-			geometry_pool.for_each_instance([&new_instances](DelayedRendererInstance *o) {
-				if (!o->is_visible || o->is_expired())
+			geometry_pool.for_each_instance([&new_instances](const DelayedRenderer &o, const AABBMinMax &bounds) {
+				if (!o.is_visible || o.is_expired())
 					return;
-				new_instances.push_back(o->bounds);
+				new_instances.push_back(bounds);
 			});
 
 			// Draw custom sphere for 1 frame
 			for (auto &i : new_instances) {
-				cfg->dcd.viewport = vp;
+				cfg->dcd = DebugDraw3DScopeConfig::DebugContainerDependent(vp, cfg->dcd.no_depth_test);
 				Vector3 diag = i.max - i.min;
 				Vector3 center = i.center;
 				real_t radius = i.radius;
@@ -301,15 +230,15 @@ void DebugGeometryContainer::update_geometry(double p_delta) {
 						SphereBounds(center, radius));
 			}
 
-			geometry_pool.for_each_line([this, &cfg, &vp](DelayedRendererLine *o) {
-				if (!o->is_visible || o->is_expired())
+			geometry_pool.for_each_line([this, &cfg, &vp](const DelayedRenderer &o, const AABBMinMax &bounds) {
+				if (!o.is_visible || o.is_expired())
 					return;
 
-				Vector3 diag = o->bounds.max - o->bounds.min;
-				Vector3 center = o->bounds.center;
-				real_t radius = o->bounds.radius;
+				Vector3 diag = bounds.max - bounds.min;
+				Vector3 center = bounds.center;
+				real_t radius = bounds.radius;
 
-				cfg->dcd.viewport = vp;
+				cfg->dcd = DebugDraw3DScopeConfig::DebugContainerDependent(vp, cfg->dcd.no_depth_test);
 				geometry_pool.add_or_update_instance(
 						cfg,
 						InstanceType::CUBE_CENTERED,
@@ -332,35 +261,74 @@ void DebugGeometryContainer::update_geometry(double p_delta) {
 
 			for (const auto &culling_data : culling_data) {
 				for (const auto &frustum : culling_data.second->m_frustums) {
-					size_t s = GeometryGenerator::CubeIndexes.size();
-					std::unique_ptr<Vector3[]> l(new Vector3[s]);
-					GeometryGenerator::CreateCameraFrustumLinesWireframe(frustum, l.get());
+					std::array<Vector3, GeometryGenerator::CubeIndexes.size()> l;
+					GeometryGenerator::CreateCameraFrustumLinesWireframe(frustum, l.data());
 
 					geometry_pool.add_or_update_line(
 							cfg,
 							0,
 							ProcessType::PROCESS,
-							std::move(l),
-							s,
+							l.data(),
+							l.size(),
 							Colors::red);
 				}
 			}
 		}
 	}
 
-	std::vector<Ref<MultiMesh> *> meshes((int)InstanceType::MAX);
-	for (int i = 0; i < (int)InstanceType::MAX; i++) {
-		meshes[i] = &multi_mesh_storage[i].mesh;
+	if (!render_instances[(int)DepthTestMode::NO_DEPTH].is_created && geometry_pool.has_objects(DepthTestMode::NO_DEPTH)) {
+		_create_render_instances(DepthTestMode::NO_DEPTH);
+	}
+
+	std::vector<MultiMeshBuffer *> meshes((int)DepthTestMode::MAX * (int)InstanceType::MAX);
+	std::vector<Ref<ArrayMesh> *> lines_meshes((int)DepthTestMode::MAX);
+	for (int d = 0; d < (int)DepthTestMode::MAX; d++) {
+		RenderInstances &ri = render_instances[d];
+		if (!ri.is_created) {
+			continue;
+		}
+
+		_update_render_instances((DepthTestMode)d, p_delta);
+		for (int i = 0; i < (int)InstanceType::MAX; i++) {
+			if (ri.multi_mesh_storage[i].is_created()) {
+				meshes[d * (int)InstanceType::MAX + i] = &ri.multi_mesh_storage[i].mesh;
+			}
+		}
+		lines_meshes[d] = &ri.immediate_mesh_storage.mesh;
 	}
 
-	geometry_pool.reset_visible_objects();
-	geometry_pool.fill_mesh_data(meshes, immediate_mesh_storage.mesh, culling_data);
+	geometry_pool.fill_mesh_data(meshes, lines_meshes, culling_data);
 
 	geometry_pool.reset_counter(p_delta, ProcessType::PROCESS);
 
 	is_frame_rendered = true;
 }
 
+void DebugGeometryContainer::_update_render_instances(const DepthTestMode &p_depth, const double &p_delta) {
+	ZoneScoped;
+	RenderInstances &ri = render_instances[(int)p_depth];
+	real_t release_time = owner->get_config()->get_unused_meshes_release_time();
+
+	bool used_types[(int)InstanceType::MAX] = {};
+	geometry_pool.get_used_types(p_depth, used_types);
+
+	for (int i = 0; i < (int)InstanceType::MAX; i++) {
+		MultiMeshStorage &s = ri.multi_mesh_storage[i];
+		if (used_types[i]) {
+			if (!s.is_created()) {
+				CreateMMI(ri, p_depth, (InstanceType)i);
+			}
+			s.unused_time = 0;
+		} else if (s.is_created()) {
+			s.unused_time += p_delta;
+			if (release_time >= 0 && s.unused_time >= release_time) {
+				DEV_PRINT_STD("Releasing unused MultiMesh of type %d for %s depth test\n", i, p_depth == DepthTestMode::NO_DEPTH ? "NoDepth" : "Normal");
+				s.release();
+			}
+		}
+	}
+}
+
 void DebugGeometryContainer::update_geometry_physics_start(double p_delta) {
 	if (is_frame_rendered) {
 		geometry_pool.reset_counter(p_delta, ProcessType::PHYSICS_PROCESS);
@@ -383,10 +351,18 @@ void DebugGeometryContainer::set_render_layer_mask(int32_t p_layers) {
 	LOCK_GUARD(owner->datalock);
 	if (render_layers != p_layers) {
 		RenderingServer *rs = RenderingServer::get_singleton();
-		for (auto &mmi : multi_mesh_storage)
-			rs->instance_set_layer_mask(mmi.instance, p_layers);
+		for (auto &ri : render_instances) {
+			if (!ri.is_created) {
+				continue;
+			}
+
+			for (auto &mmi : ri.multi_mesh_storage) {
+				if (mmi.is_created())
+					rs->instance_set_layer_mask(mmi.instance, p_layers);
+			}
 
-		rs->instance_set_layer_mask(immediate_mesh_storage.instance, p_layers);
+			rs->instance_set_layer_mask(ri.immediate_mesh_storage.instance, p_layers);
+		}
 		render_layers = p_layers;
 	}
 }
@@ -398,12 +374,19 @@ int32_t DebugGeometryContainer::get_render_layer_mask() const {
 void DebugGeometryContainer::clear_3d_objects() {
 	ZoneScoped;
 	LOCK_GUARD(owner->datalock);
-	for (auto &s : multi_mesh_storage) {
-		s.mesh->set_instance_count(0);
+	for (auto &ri : render_instances) {
+		if (!ri.is_created) {
+			continue;
+		}
+
+		for (auto &s : ri.multi_mesh_storage) {
+			s.release();
+		}
+		ri.immediate_mesh_storage.mesh->clear_surfaces();
 	}
-	immediate_mesh_storage.mesh->clear_surfaces();
 
 	geometry_pool.clear_pool();
+	geometry_pool.reset_lines_surfaces();
 }
 
 #endif
\ No newline at end of file
@@ -5,7 +5,6 @@
 
 GODOT_WARNING_DISABLE()
 #include <godot_cpp/classes/array_mesh.hpp>
-#include <godot_cpp/classes/multi_mesh.hpp>
 #include <godot_cpp/classes/rendering_server.hpp>
 #include <godot_cpp/classes/shader_material.hpp>
 #include <godot_cpp/classes/world3d.hpp>
@@ -20,14 +19,33 @@ class DebugGeometryContainer {
 
 	struct MultiMeshStorage {
 		RID instance;
-		Ref<MultiMesh> mesh;
+		MultiMeshBuffer mesh;
+		// Keeps the shared mesh alive while the MultiMesh uses it
+		Ref<ArrayMesh> base_mesh;
+		// Time since this type was used the last time
+		double unused_time = 0;
+
+		_FORCE_INLINE_ bool is_created() const {
+			return instance.is_valid();
+		}
+
+		void release() {
+			if (instance.is_valid()) {
+				RenderingServer::get_singleton()->free_rid(instance);
+				instance = RID();
+			}
+			if (mesh.multimesh.is_valid()) {
+				RenderingServer::get_singleton()->free_rid(mesh.multimesh);
+			}
+			mesh = MultiMeshBuffer();
+			base_mesh.unref();
+			unused_time = 0;
+		}
 
 		~MultiMeshStorage() {
-			RenderingServer::get_singleton()->free_rid(instance);
-			mesh.unref();
+			release();
 		}
 	};
-	MultiMeshStorage multi_mesh_storage[(int)InstanceType::MAX] = {};
 
 	struct ImmediateMeshStorage {
 		RID instance;
@@ -35,27 +53,37 @@ class DebugGeometryContainer {
 		Ref<ShaderMaterial> material;
 
 		~ImmediateMeshStorage() {
-			RenderingServer::get_singleton()->free_rid(instance);
+			if (instance.is_valid()) {
+				RenderingServer::get_singleton()->free_rid(instance);
+			}
 			mesh.unref();
 			material.unref();
 		}
 	};
-	ImmediateMeshStorage immediate_mesh_storage;
+
+	/// Render instances of a single depth test mode.
+	/// The MultiMeshes are created on the first use of their types.
+	struct RenderInstances {
+		MultiMeshStorage multi_mesh_storage[(int)InstanceType::MAX] = {};
+		ImmediateMeshStorage immediate_mesh_storage;
+		bool is_created = false;
+	};
+	RenderInstances render_instances[(int)DepthTestMode::MAX];
 
 	GeometryPool geometry_pool;
 	Ref<World3D> base_world_viewport;
 	int32_t render_layers = 1;
 	bool is_frame_rendered = false;
-	bool no_depth_test = false;
 
-	void CreateMMI(InstanceType p_type, Ref<ArrayMesh> p_mesh);
+	void _create_render_instances(const DepthTestMode &p_depth);
+	void CreateMMI(RenderInstances &p_instances, const DepthTestMode &p_depth, InstanceType p_type);
+	/// Creates the MultiMeshes of the used types and releases the unused ones.
+	void _update_render_instances(const DepthTestMode &p_depth, const double &p_delta);
 
 public:
-	DebugGeometryContainer(class DebugDraw3D *p_root, bool p_no_depth_test);
+	DebugGeometryContainer(class DebugDraw3D *p_root);
 	~DebugGeometryContainer();
 
-	bool is_no_depth_test() const;
-
 	void set_world(Ref<World3D> p_new_world);
 	Ref<World3D> get_world();
 
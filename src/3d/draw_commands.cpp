@@ -0,0 +1,102 @@
+#include "draw_commands.h"
+
+#ifndef DISABLE_DEBUG_RENDERING
+
+#include "utils/profiler.h"
+
+#include <thread>
+
+uint32_t DrawCommands::get_config_index(DebugDraw3DScopeConfig::Data *p_cfg) {
+	// The config can be changed after this call, so a copy of it is stored until the commands are merged
+	if (configs.empty() || !configs.back()->is_equal(p_cfg)) {
+		configs.push_back(std::make_shared<DebugDraw3DScopeConfig::Data>(p_cfg));
+	}
+	return (uint32_t)configs.size() - 1;
+}
+
+void DrawCommands::add_instance(DebugDraw3DScopeConfig::Data *p_cfg, const int &p_type, const bool &p_is_convertable_type, const real_t &p_exp_time, const ProcessType &p_proc, const Transform3D &p_transform, const Color &p_col, const SphereBounds &p_bounds, const Color *p_custom_col) {
+	Instance &i = instances.emplace_back();
+	i.transform = p_transform;
+	i.color = p_col;
+	i.custom_color = p_custom_col ? *p_custom_col : Color();
+	i.bounds = p_bounds;
+	i.exp_time = p_exp_time;
+	i.config = get_config_index(p_cfg);
+	i.type = p_type;
+	i.is_convertable_type = p_is_convertable_type;
+	i.has_custom_color = p_custom_col != nullptr;
+	i.proc = p_proc;
+}
+
+size_t DrawCommands::add_instances(DebugDraw3DScopeConfig::Data *p_cfg, const int &p_type, const bool &p_is_convertable_type, const real_t &p_exp_time, const ProcessType &p_proc, const size_t &p_count, const Color *p_custom_col) {
+	size_t offset = batch_transforms.size();
+
+	InstancesBatch &b = batches.emplace_back();
+	b.offset = offset;
+	b.count = p_count;
+	b.custom_color = p_custom_col ? *p_custom_col : Color();
+	b.exp_time = p_exp_time;
+	b.config = get_config_index(p_cfg);
+	b.type = p_type;
+	b.is_convertable_type = p_is_convertable_type;
+	b.has_custom_color = p_custom_col != nullptr;
+	b.proc = p_proc;
+
+	batch_transforms.resize(offset + p_count);
+	batch_colors.resize(offset + p_count);
+	batch_bounds.resize(offset + p_count);
+	return offset;
+}
+
+void DrawCommands::add_lines(DebugDraw3DScopeConfig::Data *p_cfg, const real_t &p_exp_time, const ProcessType &p_proc, const Vector3 *p_lines, const size_t &p_line_count, const Color &p_col) {
+	Lines &l = lines.emplace_back();
+	l.offset = points->size();
+	l.count = p_line_count;
+	l.color = p_col;
+	l.exp_time = p_exp_time;
+	l.config = get_config_index(p_cfg);
+	l.proc = p_proc;
+
+	points->insert(points->end(), p_lines, p_lines + p_line_count);
+}
+
+void DrawCommands::clear() {
+	configs.clear();
+	instances.clear();
+	batches.clear();
+	batch_transforms.clear();
+	batch_colors.clear();
+	batch_bounds.clear();
+	lines.clear();
+
+	// The points are still used by the GeometryPool
+	if (points.use_count() > 1) {
+		size_t prev_size = points->size();
+		points = std::make_shared<std::vector<Vector3> >();
+		points->reserve(prev_size);
+	} else {
+		points->clear();
+	}
+}
+
+DrawCommands *ThreadDrawCommands::swap() {
+	ZoneScoped;
+	DrawCommands *current = active.load(std::memory_order_acquire);
+	while (true) {
+		// The owner thread is writing a command
+		if (!current) {
+			std::this_thread::yield();
+			current = active.load(std::memory_order_acquire);
+			continue;
+		}
+
+		if (active.compare_exchange_weak(current, spare, std::memory_order_acq_rel, std::memory_order_acquire)) {
+			break;
+		}
+	}
+
+	spare = current;
+	return current;
+}
+
+#endif
@@ -0,0 +1,121 @@
+#pragma once
+
+#ifndef DISABLE_DEBUG_RENDERING
+
+#include "config_scope_3d.h"
+#include "render_instances_enums.h"
+#include "utils/math_utils.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+GODOT_WARNING_DISABLE()
+#include <godot_cpp/variant/builtin_types.hpp>
+GODOT_WARNING_RESTORE()
+using namespace godot;
+
+/// Draw calls recorded by a single thread. They are added to the GeometryPool when the buffers are merged.
+struct DrawCommands {
+	struct Instance {
+		Transform3D transform;
+		Color color;
+		Color custom_color;
+		SphereBounds bounds;
+		real_t exp_time;
+		uint32_t config;
+		// InstanceType or ConvertableInstanceType
+		int type;
+		bool is_convertable_type;
+		bool has_custom_color;
+		ProcessType proc;
+	};
+
+	/// Instances of the same type and config. Their data is stored in the `batch_*` arrays.
+	struct InstancesBatch {
+		size_t offset;
+		size_t count;
+		Color custom_color;
+		real_t exp_time;
+		uint32_t config;
+		int type;
+		bool is_convertable_type;
+		bool has_custom_color;
+		ProcessType proc;
+	};
+
+	struct Lines {
+		size_t offset;
+		size_t count;
+		Color color;
+		real_t exp_time;
+		uint32_t config;
+		ProcessType proc;
+	};
+
+	// Configs are stored once for every sequence of commands with the same config
+	std::vector<std::shared_ptr<DebugDraw3DScopeConfig::Data> > configs;
+	std::vector<Instance> instances;
+	std::vector<InstancesBatch> batches;
+	std::vector<Transform3D> batch_transforms;
+	std::vector<Color> batch_colors;
+	std::vector<SphereBounds> batch_bounds;
+	std::vector<Lines> lines;
+	// Shared with the GeometryPool, which keeps the instant lines in it until the end of the frame
+	std::shared_ptr<std::vector<Vector3> > points = std::make_shared<std::vector<Vector3> >();
+
+	uint32_t get_config_index(DebugDraw3DScopeConfig::Data *p_cfg);
+	void add_instance(DebugDraw3DScopeConfig::Data *p_cfg, const int &p_type, const bool &p_is_convertable_type, const real_t &p_exp_time, const ProcessType &p_proc, const Transform3D &p_transform, const Color &p_col, const SphereBounds &p_bounds, const Color *p_custom_col);
+	/// Adds a batch of `p_count` instances and returns the offset of the first one in the `batch_*` arrays.
+	/// The arrays are resized once and must be filled by the caller.
+	size_t add_instances(DebugDraw3DScopeConfig::Data *p_cfg, const int &p_type, const bool &p_is_convertable_type, const real_t &p_exp_time, const ProcessType &p_proc, const size_t &p_count, const Color *p_custom_col);
+	void add_lines(DebugDraw3DScopeConfig::Data *p_cfg, const real_t &p_exp_time, const ProcessType &p_proc, const Vector3 *p_lines, const size_t &p_line_count, const Color &p_col);
+
+	_FORCE_INLINE_ bool empty() const {
+		return instances.empty() && batches.empty() && lines.empty();
+	}
+
+	void clear();
+};
+
+/// Double buffered commands of a single thread.
+/// The owner thread writes without locking, and the merging thread swaps the buffers.
+/// The merging thread waits only if the owner is in the middle of writing a command.
+class ThreadDrawCommands {
+	DrawCommands buffers[2];
+	std::atomic<DrawCommands *> active;
+	// The buffer that is not available to the writer. Used only by the merging thread.
+	DrawCommands *spare;
+	std::atomic_bool thread_exited;
+
+public:
+	ThreadDrawCommands() :
+			active(&buffers[0]),
+			spare(&buffers[1]),
+			thread_exited(false) {}
+
+	/// Called by the owner thread when it exits or stops using these commands.
+	_FORCE_INLINE_ void mark_thread_exited() {
+		thread_exited.store(true, std::memory_order_release);
+	}
+
+	/// If true, no more commands will be recorded after the next `swap`.
+	_FORCE_INLINE_ bool is_thread_exited() const {
+		return thread_exited.load(std::memory_order_acquire);
+	}
+
+	/// Takes the active buffer. Must be followed by `end_write`.
+	_FORCE_INLINE_ DrawCommands *begin_write() {
+		return active.exchange(nullptr, std::memory_order_acquire);
+	}
+
+	_FORCE_INLINE_ void end_write(DrawCommands *p_buffer) {
+		active.store(p_buffer, std::memory_order_release);
+	}
+
+	/// Replaces the active buffer with the empty one and returns the recorded commands.
+	/// The returned buffer must be cleared before the next call.
+	DrawCommands *swap();
+};
+
+#endif
@@ -6,125 +6,600 @@
 
 GODOT_WARNING_DISABLE()
 #include <godot_cpp/classes/mesh.hpp>
-#include <godot_cpp/classes/multi_mesh.hpp>
+#include <godot_cpp/classes/rendering_server.hpp>
+#include <godot_cpp/classes/worker_thread_pool.hpp>
 GODOT_WARNING_RESTORE()
 
-bool DelayedRenderer::update_visibility(const std::shared_ptr<GeometryPoolCullingData> &p_culling_data) {
-	is_visible = false;
-	for (auto &box : p_culling_data->m_frustum_boxes) {
-		if (box.intersects(bounds)) {
-			goto frustum;
+void _DD3D_GroupTask::_bind_methods() {
+	ClassDB::bind_method(D_METHOD(NAMEOF(_execute), "index"), &_DD3D_GroupTask::_execute);
+}
+
+void _DD3D_GroupTask::_execute(int p_index) {
+	m_func(p_index);
+}
+
+void _DD3D_GroupTask::run(const std::function<void(int)> &p_func, const int &p_count, const String &p_description) {
+	ZoneScoped;
+	m_func = p_func;
+
+	WorkerThreadPool *wtp = WorkerThreadPool::get_singleton();
+	int64_t id = wtp->add_group_task(Callable(this, NAMEOF(_execute)), p_count, -1, true, p_description);
+	wtp->wait_for_group_task_completion(id);
+
+	m_func = nullptr;
+}
+
+/// Culls the objects using only their bounds and appends the visible ones as ranges of the contiguous payload.
+/// If `r_culled_small` is specified, the objects smaller than the minimum size on the screen are culled and counted in it.
+/// Returns the number of visible objects.
+template <class TData>
+static size_t cull_objects(const GeometryPoolCullingData *p_culling_data, const AABBMinMax *p_bounds, DelayedRenderer *p_states, const TData *p_data, const size_t &p_count, std::vector<uint32_t> &r_mask_buffer, std::vector<VisibleRange<TData> > &r_visible, size_t *r_culled_small = nullptr) {
+	if (!p_count) {
+		return 0;
+	}
+
+	r_mask_buffer.resize((p_count + 31) / 32);
+	uint32_t *mask = r_mask_buffer.data();
+	MathUtils::cull_bounds_batch(p_bounds, p_count, p_culling_data->m_frustum_boxes.data(), p_culling_data->m_frustum_boxes.size(), p_culling_data->m_frustums.data(), p_culling_data->m_frustums.size(), mask);
+	bool check_size = r_culled_small && p_culling_data->has_small_objects_culling();
+
+	size_t visible = 0;
+	for (size_t i = 0; i < p_count; i++) {
+		auto &s = p_states[i];
+		s.is_visible = (mask[i / 32] >> (i % 32)) & 1;
+		if (s.is_visible && check_size && p_culling_data->is_too_small(p_bounds[i])) {
+			s.is_visible = false;
+			(*r_culled_small)++;
+		}
+		if (s.is_visible) {
+			visible++;
+			if (r_visible.size() && r_visible.back().data + r_visible.back().count == p_data + i) {
+				r_visible.back().count++;
+			} else {
+				r_visible.push_back({ p_data + i, p_bounds + i, 1 });
+			}
 		}
 	}
-	return is_visible;
-frustum:
-	if (p_culling_data->m_frustums.size()) {
-		for (auto &frustum : p_culling_data->m_frustums) {
-			if (MathUtils::is_bounds_partially_inside_convex_shape(bounds, frustum)) {
-				return is_visible = true;
+	return visible;
+}
+
+bool GeometryPoolCullingData::is_equal(const GeometryPoolCullingData &p_other) const {
+	if (m_lod_low_size != p_other.m_lod_low_size || m_lod_high_size != p_other.m_lod_high_size || m_min_pixel_radius != p_other.m_min_pixel_radius) {
+		return false;
+	}
+
+	if (m_frustums.size() != p_other.m_frustums.size() || m_frustum_boxes.size() != p_other.m_frustum_boxes.size() || m_cameras.size() != p_other.m_cameras.size()) {
+		return false;
+	}
+
+	for (size_t i = 0; i < m_frustums.size(); i++) {
+		for (size_t j = 0; j < m_frustums[i].size(); j++) {
+			if (m_frustums[i][j] != p_other.m_frustums[i][j]) {
+				return false;
 			}
 		}
-		return is_visible = false;
-	} else {
-		return is_visible = true;
+	}
+
+	for (size_t i = 0; i < m_frustum_boxes.size(); i++) {
+		if (m_frustum_boxes[i].min != p_other.m_frustum_boxes[i].min || m_frustum_boxes[i].max != p_other.m_frustum_boxes[i].max) {
+			return false;
+		}
+	}
+
+	for (size_t i = 0; i < m_cameras.size(); i++) {
+		const GeometryPoolCamera &a = m_cameras[i];
+		const GeometryPoolCamera &b = p_other.m_cameras[i];
+		if (a.position != b.position || a.size_scale != b.size_scale || a.viewport_height != b.viewport_height || a.is_orthogonal != b.is_orthogonal) {
+			return false;
+		}
+	}
+	return true;
+}
+
+Vector3 *LinesArena::alloc(const size_t &p_count) {
+	while (current_block < blocks.size()) {
+		Block &block = blocks[current_block];
+		if (block.size - used_in_block >= p_count) {
+			Vector3 *res = block.data.get() + used_in_block;
+			used_in_block += p_count;
+			used_total += p_count;
+			return res;
+		}
+		current_block++;
+		used_in_block = 0;
+	}
+
+	size_t new_size = std::max((size_t)MIN_BLOCK_SIZE, std::max(p_count, used_total));
+	blocks.push_back({ std::unique_ptr<Vector3[]>(new Vector3[new_size]), new_size });
+	used_in_block = p_count;
+	used_total += p_count;
+	return blocks.back().data.get();
+}
+
+void LinesArena::adopt(const std::shared_ptr<const std::vector<Vector3> > &p_buffer) {
+	if (adopted.empty() || adopted.back() != p_buffer) {
+		adopted.push_back(p_buffer);
+	}
+}
+
+void LinesArena::reset() {
+	adopted.clear();
+
+	// Replace the blocks with one big block to keep the memory contiguous
+	if (blocks.size() > 1) {
+		size_t new_size = 0;
+		for (auto &b : blocks) {
+			new_size += b.size;
+		}
+
+		blocks.clear();
+		blocks.push_back({ std::unique_ptr<Vector3[]>(new Vector3[new_size]), new_size });
+	} else if (blocks.size() == 1 && blocks[0].size > MIN_BLOCK_SIZE && used_total < blocks[0].size / 4) {
+		size_t new_size = std::max((size_t)MIN_BLOCK_SIZE, blocks[0].size / 2);
+		blocks[0] = { std::unique_ptr<Vector3[]>(new Vector3[new_size]), new_size };
+	}
+
+	current_block = 0;
+	used_in_block = 0;
+	used_total = 0;
+}
+
+void LinesArena::clear() {
+	blocks.clear();
+	adopted.clear();
+	current_block = 0;
+	used_in_block = 0;
+	used_total = 0;
+}
+
+GeometryPool::~GeometryPool() {
+	if (group_task) {
+		memdelete(group_task);
+		group_task = nullptr;
 	}
 }
 
-DelayedRendererInstance::DelayedRendererInstance() :
-		DelayedRenderer() {
-	DEV_PRINT_STD("New " NAMEOF(DelayedRendererInstance) " created\n");
+bool GeometryPool::has_objects(const DepthTestMode &p_depth) {
+	for (auto &vp_pool : pools) {
+		for (int proc_i = 0; proc_i < (int)ProcessType::MAX; proc_i++) {
+			auto &proc = vp_pool.second[_get_pools_index(p_depth, (ProcessType)proc_i)];
+			for (auto &i : proc.instances) {
+				if (i.used_instant || i.used_delayed) {
+					return true;
+				}
+			}
+			if (proc.lines.used_instant || proc.lines.used_delayed) {
+				return true;
+			}
+		}
+	}
+	return false;
 }
 
-DelayedRendererLine::DelayedRendererLine() :
-		DelayedRenderer(),
-		lines_count(0) {
-	DEV_PRINT_STD("New " NAMEOF(DelayedRendererLine) " created\n");
+void GeometryPool::get_used_types(const DepthTestMode &p_depth, bool *p_used) {
+	for (auto &vp_pool : pools) {
+		for (int proc_i = 0; proc_i < (int)ProcessType::MAX; proc_i++) {
+			auto &proc = vp_pool.second[_get_pools_index(p_depth, (ProcessType)proc_i)];
+			for (int type = 0; type < (int)InstanceType::MAX; type++) {
+				auto &i = proc.instances[type];
+				if (!i.used_instant && !i.used_delayed) {
+					continue;
+				}
+
+				for (int lod = 0; lod < (int)InstanceLOD::MAX; lod++) {
+					p_used[(int)_get_lod_type((InstanceType)type, (InstanceLOD)lod)] = true;
+				}
+			}
+		}
+	}
 }
 
-void GeometryPool::fill_mesh_data(const std::vector<Ref<MultiMesh> *> &p_meshes, Ref<ArrayMesh> p_ig, std::unordered_map<Viewport *, std::shared_ptr<GeometryPoolCullingData> > &p_culling_data) {
+void GeometryPool::fill_mesh_data(const std::vector<MultiMeshBuffer *> &p_meshes, const std::vector<Ref<ArrayMesh> *> &p_lines_meshes, std::unordered_map<Viewport *, std::shared_ptr<GeometryPoolCullingData> > &p_culling_data) {
 	ZoneScoped;
-	fill_instance_data(p_meshes, p_culling_data);
-	fill_lines_data(p_ig, p_culling_data);
 
+	if (_is_frame_unchanged(p_meshes, p_culling_data)) {
+		// The buffers and the visibility stats of the last frame are kept
+		stat_skipped_frames++;
+		time_spent_to_cull_instances = 0;
+		time_spent_to_fill_buffers_of_instances = 0;
+		time_spent_to_cull_lines = 0;
+		time_spent_to_fill_buffers_of_lines = 0;
+	} else {
+		reset_visible_objects();
+		fill_instance_data(p_meshes, p_culling_data);
+		fill_lines_data(p_lines_meshes, p_culling_data);
+
+		filled_objects_generation = objects_generation;
+		filled_pools_layout_version = pools_layout_version;
+		filled_meshes.resize(p_meshes.size());
+		for (size_t i = 0; i < p_meshes.size(); i++) {
+			filled_meshes[i] = p_meshes[i] ? p_meshes[i]->multimesh : RID();
+		}
+		filled_culling_data = p_culling_data;
+	}
+
+	stat_evicted_objects = frame_evicted_objects;
+	stat_rejected_objects = frame_rejected_objects;
+	stat_deduplicated_objects = frame_deduplicated_objects;
+	frame_deduplicated_objects = 0;
+	if (frame_evicted_objects || frame_rejected_objects) {
+		PRINT_WARNING("The limits of the debug geometry have been reached. Evicted: {0}, rejected: {1}.", (int64_t)frame_evicted_objects, (int64_t)frame_rejected_objects);
+		frame_evicted_objects = 0;
+		frame_rejected_objects = 0;
+	}
+	_update_used_bytes();
+
+	process_time += process_delta_sum;
+	physics_time += physics_delta_sum;
 	process_delta_sum = 0;
 	physics_delta_sum = 0;
 }
 
-void GeometryPool::fill_instance_data(const std::vector<Ref<MultiMesh> *> &p_meshes, std::unordered_map<Viewport *, std::shared_ptr<GeometryPoolCullingData> > &p_culling_data) {
+bool GeometryPool::_is_frame_unchanged(const std::vector<MultiMeshBuffer *> &p_meshes, std::unordered_map<Viewport *, std::shared_ptr<GeometryPoolCullingData> > &p_culling_data) {
+	ZoneScoped;
+	if (objects_generation != filled_objects_generation || pools_layout_version != filled_pools_layout_version) {
+		return false;
+	}
+
+	if (p_meshes.size() != filled_meshes.size()) {
+		return false;
+	}
+	for (size_t i = 0; i < p_meshes.size(); i++) {
+		if ((p_meshes[i] ? p_meshes[i]->multimesh : RID()) != filled_meshes[i]) {
+			return false;
+		}
+	}
+
+	// The culling data is created every frame, so it is compared by value
+	for (auto &vp_pool : pools) {
+		auto cur = p_culling_data.find(vp_pool.first);
+		auto prev = filled_culling_data.find(vp_pool.first);
+		const GeometryPoolCullingData *a = cur != p_culling_data.end() ? cur->second.get() : nullptr;
+		const GeometryPoolCullingData *b = prev != filled_culling_data.end() ? prev->second.get() : nullptr;
+		if (a != b && (!a || !b || !a->is_equal(*b))) {
+			return false;
+		}
+	}
+
+	// Expiration of the delayed objects is checked with the time before the current delta is added
+	for (auto &vp_pool : pools) {
+		for (int pools_i = 0; pools_i < POOLS_PER_VIEWPORT; pools_i++) {
+			auto &proc = vp_pool.second[pools_i];
+			double time = pools_i % (int)ProcessType::MAX == (int)ProcessType::PHYSICS_PROCESS ? physics_time : process_time;
+			for (auto &i : proc.instances) {
+				if (i.has_expiring_delayed(time)) {
+					return false;
+				}
+			}
+			if (proc.lines.has_expiring_delayed(time)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+void GeometryPool::_cull_instances_task(InstancesFillTask &p_task) {
+	ZoneScoped;
+	auto &arr = *p_task.arr;
+
+	p_task.culled_small = 0;
+	p_task.visible_ranges.clear();
+	p_task.changed_slots.clear();
+	p_task.is_lod_split = false;
+
+	if (p_task.is_delayed) {
+		p_task.pool->update_delayed_expiration(p_task.is_physics ? physics_time : process_time);
+		p_task.visible = p_task.pool->cull_delayed(p_task.culling_data, p_task.visibility_mask, p_task.visible_ranges, &p_task.changed_slots, &p_task.culled_small);
+	} else {
+		p_task.visible = cull_objects(p_task.culling_data, arr.bounds.data() + p_task.start, arr.states.data() + p_task.start, arr.data.data() + p_task.start, p_task.count, p_task.visibility_mask, p_task.visible_ranges, &p_task.culled_small);
+	}
+
+	for (auto &o : p_task.outputs) {
+		o.visible = 0;
+		o.visible_ranges.clear();
+	}
+
+	if (p_task.outputs[(int)InstanceLOD::LOW].type != p_task.type || p_task.outputs[(int)InstanceLOD::HIGH].type != p_task.type) {
+		if (p_task.culling_data->has_lod()) {
+			p_task.is_lod_split = true;
+			_split_instances_by_lod(p_task);
+			return;
+		}
+	}
+
+	InstancesFillOutput &o = p_task.outputs[(int)InstanceLOD::NORMAL];
+	o.visible = p_task.visible;
+	std::swap(o.visible_ranges, p_task.visible_ranges);
+}
+
+void GeometryPool::_split_instances_by_lod(InstancesFillTask &p_task) {
+	ZoneScoped;
+	auto &arr = *p_task.arr;
+	const GeometryPoolCullingData *culling = p_task.culling_data;
+
+	for (auto &range : p_task.visible_ranges) {
+		for (size_t j = 0; j < range.count; j++) {
+			InstanceLOD lod = culling->get_lod(range.bounds[j]);
+			// This LOD is not used by the type
+			if (p_task.outputs[(int)lod].type == p_task.type) {
+				lod = InstanceLOD::NORMAL;
+			}
+
+			// The object is moved to the slot of another buffer
+			if (p_task.is_delayed) {
+				size_t idx = range.data + j - arr.data.data();
+				DelayedRenderer &s = arr.states[idx];
+				if (s.lod != lod) {
+					s.lod = lod;
+					p_task.changed_slots.push_back((uint32_t)idx);
+				}
+			}
+
+			InstancesFillOutput &o = p_task.outputs[(int)lod];
+			const GeometryPoolData3DInstance *data = range.data + j;
+			if (o.visible_ranges.size() && o.visible_ranges.back().data + o.visible_ranges.back().count == data) {
+				o.visible_ranges.back().count++;
+			} else {
+				o.visible_ranges.push_back({ data, range.bounds + j, 1 });
+			}
+			o.visible++;
+		}
+	}
+}
+
+void GeometryPool::_write_instance(InstancesFillOutput &o, const size_t &p_idx, const float *p_data) {
+	float *w = o.buffer_write + p_idx * INSTANCE_DATA_FLOAT_COUNT;
+	if (memcmp(w, p_data, INSTANCE_DATA_FLOAT_COUNT * sizeof(float)) == 0) {
+		return;
+	}
+	memcpy(w, p_data, INSTANCE_DATA_FLOAT_COUNT * sizeof(float));
+
+	size_t idx = o.buffer_offset + p_idx;
+	if (o.changed_ranges.size() && o.changed_ranges.back().start + o.changed_ranges.back().count == idx) {
+		o.changed_ranges.back().count++;
+	} else {
+		o.changed_ranges.push_back({ idx, 1 });
+	}
+	o.changed_count++;
+}
+
+void GeometryPool::_fill_instances_task(InstancesFillTask &p_task) {
+	ZoneScoped;
+	for (auto &o : p_task.outputs) {
+		o.bounds.reset();
+		o.changed_ranges.clear();
+		o.changed_count = 0;
+
+		for (auto &range : o.visible_ranges) {
+			for (size_t i = 0; i < range.count; i++) {
+				o.bounds.merge_with(range.bounds[i]);
+			}
+		}
+	}
+
+	if (!p_task.is_delayed) {
+		for (auto &o : p_task.outputs) {
+			if (!o.buffer_write) {
+				continue;
+			}
+
+			size_t idx = 0;
+			for (auto &range : o.visible_ranges) {
+				for (size_t i = 0; i < range.count; i++) {
+					_write_instance(o, idx++, reinterpret_cast<const float *>(range.data + i));
+				}
+			}
+		}
+		return;
+	}
+
+	// Hides the slots of the expired and invisible objects
+	static const float zero_instance[INSTANCE_DATA_FLOAT_COUNT] = {};
+	auto &arr = *p_task.arr;
+
+	// The object is written to the buffer of its LOD and the same slot of other buffers is hidden
+	auto write_slot = [&](const size_t &p_idx) {
+		const float *data = nullptr;
+		int data_type = -1;
+		if (p_idx < arr.size() && arr.states[p_idx].is_visible) {
+			InstanceLOD lod = p_task.is_lod_split ? arr.states[p_idx].lod : InstanceLOD::NORMAL;
+			data_type = p_task.outputs[(int)lod].type;
+			data = reinterpret_cast<const float *>(arr.data.data() + p_idx);
+		}
+
+		for (int lod = 0; lod < (int)InstanceLOD::MAX; lod++) {
+			InstancesFillOutput &o = p_task.outputs[lod];
+			if (o.buffer_write && _get_slots_owner_lod(p_task, lod) == lod) {
+				_write_instance(o, p_idx, o.type == data_type ? data : zero_instance);
+			}
+		}
+	};
+
+	if (p_task.is_refill) {
+		for (size_t i = 0; i < p_task.delayed_slots; i++) {
+			write_slot(i);
+		}
+	} else {
+		for (uint32_t i : p_task.changed_slots) {
+			write_slot(i);
+		}
+	}
+}
+
+void GeometryPool::fill_instance_data(const std::vector<MultiMeshBuffer *> &p_meshes, std::unordered_map<Viewport *, std::shared_ptr<GeometryPoolCullingData> > &p_culling_data) {
 	ZoneScoped;
 
 	// reset timers
 	time_spent_to_cull_instances = 0;
 	time_spent_to_fill_buffers_of_instances = 0;
 
-	for (int type = 0; type < (int)InstanceType::MAX; type++) {
-		ZoneScopedN("Fill iteration");
-		ZoneValue(type);
-		GODOT_STOPWATCH_ADD(&time_spent_to_fill_buffers_of_instances);
-
-		std::vector<DelayedRendererInstance *> visible_buffer;
-		visible_buffer.reserve(prev_buffer_visible_instance_count[type]);
-
+	{
+		GODOT_STOPWATCH(&time_spent_to_fill_buffers_of_instances);
+
+		// Split all arrays into independent tasks.
+		// Each type of each depth test mode has its own buffer. The types without meshes are skipped.
+		// The delayed objects of all types are placed first in their buffers and each of them has a stable slot there.
+		// Their tasks are created before the others, so a changed number of the instant objects does not move them.
+		// The delayed arrays are culled by their trees, so they are not split.
+		// Objects of the types with LOD can be written to the buffers of other types.
+		size_t task_count = 0;
+		size_t total_objects = 0;
 		{
-			ZoneScopedN("Update visibility and expiration");
+			ZoneScopedN("Prepare tasks");
+
+			auto add_task = [&](const DepthTestMode &p_depth, int p_type, ObjectsPool<GeometryPoolData3DInstance> *p_pool, ObjectsArrays<GeometryPoolData3DInstance> *p_arr, size_t p_count, const GeometryPoolCullingData *p_culling, bool p_is_delayed, bool p_is_physics) {
+				total_objects += p_count;
+				size_t max_task_objects = p_is_delayed ? std::max(p_count, (size_t)1) : (size_t)INSTANCES_TASK_MAX_OBJECTS;
+				for (size_t start = 0; start < p_count; start += max_task_objects) {
+					if (task_count == instances_fill_tasks.size()) {
+						instances_fill_tasks.emplace_back();
+					}
 
-			for (auto &vp_pool : pools) {
-				GODOT_STOPWATCH_ADD(&time_spent_to_cull_instances);
-				auto &culling_data = p_culling_data[vp_pool.first];
+					InstancesFillTask &task = instances_fill_tasks[task_count++];
+					task.type = _get_buffer_index(p_depth, p_type);
+					task.pool = p_pool;
+					task.arr = p_arr;
+					task.culling_data = p_culling;
+					task.start = start;
+					task.count = std::min(max_task_objects, p_count - start);
+					task.is_delayed = p_is_delayed;
+					task.is_physics = p_is_physics;
+					for (int lod = 0; lod < (int)InstanceLOD::MAX; lod++) {
+						// The objects stay in their own buffer if the LOD mesh is not created
+						int lod_type = _get_buffer_index(p_depth, (int)_get_lod_type((InstanceType)p_type, (InstanceLOD)lod));
+						task.outputs[lod].type = p_meshes[lod_type] ? lod_type : task.type;
+					}
 
-				for (int proc_i = 0; proc_i < (int)ProcessType::MAX; proc_i++) {
-					auto &itype = vp_pool.second[proc_i].instances[type];
+					// The spare slots are reserved, so the new objects do not move the slots of the next tasks
+					if (!p_is_delayed) {
+						task.delayed_slots = 0;
+					} else if (task.prev_arr != p_arr || p_count > task.prev_delayed_slots || p_count < task.prev_delayed_slots / 4) {
+						task.delayed_slots = p_count + p_count / 4;
+					} else {
+						task.delayed_slots = task.prev_delayed_slots;
+					}
+				}
+			};
 
-					auto &inst_arr = itype.instant;
-					for (int i = 0; i < itype.used_instant; i++) {
-						auto &inst = inst_arr[i];
-						if (inst.update_visibility(culling_data)) {
-							visible_buffer.push_back(&inst);
+			for (int is_delayed = 1; is_delayed >= 0; is_delayed--) {
+				for (int depth_i = 0; depth_i < (int)DepthTestMode::MAX; depth_i++) {
+					DepthTestMode depth = (DepthTestMode)depth_i;
+
+					for (int type = 0; type < (int)InstanceType::MAX; type++) {
+						if (!p_meshes[_get_buffer_index(depth, type)]) {
+							continue;
 						}
-					}
 
-					itype.used_delayed = 0;
-					if (proc_i == (int)ProcessType::PHYSICS_PROCESS) {
-						for (auto &inst : itype.delayed) {
-							if (!inst.is_expired()) {
-								if (inst.is_used_one_time) {
-									inst.expiration_time -= physics_delta_sum;
-								}
-								inst.is_used_one_time = true;
-								itype.used_delayed++;
+						for (auto &vp_pool : pools) {
+							const GeometryPoolCullingData *culling_data = p_culling_data[vp_pool.first].get();
+
+							for (int proc_i = 0; proc_i < (int)ProcessType::MAX; proc_i++) {
+								auto &itype = vp_pool.second[_get_pools_index(depth, (ProcessType)proc_i)].instances[type];
+								bool is_physics = proc_i == (int)ProcessType::PHYSICS_PROCESS;
 
-								if (inst.update_visibility(culling_data)) {
-									visible_buffer.push_back(&inst);
+								if (is_delayed) {
+									add_task(depth, type, &itype, &itype.delayed, itype.delayed.size(), culling_data, true, is_physics);
+								} else {
+									add_task(depth, type, &itype, &itype.instant, itype.used_instant, culling_data, false, is_physics);
 								}
 							}
 						}
+					}
+				}
+			}
+		}
+
+		bool use_threads = task_count > 1 && total_objects >= INSTANCES_MIN_OBJECTS_FOR_THREADS;
+		if (use_threads && !group_task) {
+			group_task = memnew(_DD3D_GroupTask);
+		}
+
+		{
+			ZoneScopedN("Update visibility and expiration");
+			ZoneValue(task_count);
+			GODOT_STOPWATCH(&time_spent_to_cull_instances);
+
+			if (use_threads) {
+				group_task->run([this](int i) { _cull_instances_task(instances_fill_tasks[i]); }, (int)task_count, "DD3D instances culling");
+			} else {
+				for (size_t i = 0; i < task_count; i++) {
+					_cull_instances_task(instances_fill_tasks[i]);
+				}
+			}
+		}
+
+		// Number of the used instances of each buffer, including the hidden slots of the delayed objects
+		size_t used_count[INSTANCE_BUFFERS_COUNT] = {};
+		size_t visible_count[INSTANCE_BUFFERS_COUNT] = {};
+		bool is_layout_changed = pools_layout_version != uploaded_pools_layout_version;
+		uploaded_pools_layout_version = pools_layout_version;
+		{
+			ZoneScopedN("Calculate offsets");
+			// The tasks of the delayed objects go first
+			for (size_t i = 0; i < task_count; i++) {
+				InstancesFillTask &task = instances_fill_tasks[i];
+				stat_culled_small_instances += task.culled_small;
+
+				for (int lod = 0; lod < (int)InstanceLOD::MAX; lod++) {
+					InstancesFillOutput &o = task.outputs[lod];
+					visible_count[o.type] += o.visible;
+
+					if (!task.is_delayed) {
+						o.buffer_offset = used_count[o.type];
+						used_count[o.type] += o.visible;
+						continue;
+					}
+
+					int owner = _get_slots_owner_lod(task, lod);
+					if (owner != lod) {
+						o.buffer_offset = task.outputs[owner].buffer_offset;
 					} else {
-						for (auto &inst : itype.delayed) {
-							if (!inst.is_expired()) {
-								inst.expiration_time -= process_delta_sum;
-								inst.is_used_one_time = true;
-								itype.used_delayed++;
-
-								if (inst.update_visibility(culling_data)) {
-									visible_buffer.push_back(&inst);
-								}
-							}
-						}
+						o.buffer_offset = used_count[o.type];
+						used_count[o.type] += task.delayed_slots;
 					}
 				}
 
-				stat_visible_instances += visible_buffer.size();
-				prev_buffer_visible_instance_count[type] = visible_buffer.size();
+				if (task.is_delayed) {
+					task.is_refill = is_layout_changed ||
+									 task.prev_arr != task.arr ||
+									 task.prev_relocations != task.pool->delayed_relocations ||
+									 task.prev_delayed_slots != task.delayed_slots ||
+									 task.prev_is_lod_split != task.is_lod_split;
+					for (auto &o : task.outputs) {
+						task.is_refill |= o.type != o.prev_type || o.buffer_offset != o.prev_buffer_offset;
+					}
+				}
 			}
 		}
 
-		PackedFloat32Array &buffer = temp_instances_buffers[type];
-		size_t used_buffer_size = visible_buffer.size() * INSTANCE_DATA_FLOAT_COUNT;
+		// The buffers that were empty in the previous frame and are empty now are not touched at all.
+		bool is_skipped[INSTANCE_BUFFERS_COUNT] = {};
+		// The new MultiMeshes do not have the data of the previous ones
+		bool is_full_upload[INSTANCE_BUFFERS_COUNT] = {};
+
+		for (int type = 0; type < INSTANCE_BUFFERS_COUNT; type++) {
+			if (!p_meshes[type]) {
+				uploaded_meshes[type] = RID();
+				prev_buffer_visible_instance_count[type] = 0;
+				is_skipped[type] = true;
+				continue;
+			}
+
+			if (!used_count[type] && !prev_buffer_visible_instance_count[type] && !temp_instances_buffers[type].size() && p_meshes[type]->multimesh == uploaded_meshes[type]) {
+				is_skipped[type] = true;
+				continue;
+			}
+			stat_visible_instances += visible_count[type];
+			prev_buffer_visible_instance_count[type] = used_count[type];
+
+			PackedFloat32Array &buffer = temp_instances_buffers[type];
+			size_t used_buffer_size = used_count[type] * INSTANCE_DATA_FLOAT_COUNT;
 
-		{
 			ZoneScopedN("Prepare buffer");
 			ZoneValue(buffer.size());
 
+			// The instances of the resized buffer are reallocated in the MultiMesh, so it is uploaded entirely
 			if ((int64_t)used_buffer_size > buffer.size()) {
 				ZoneScopedN("Resize buffer (grew)");
 				ZoneValue(used_buffer_size);
@@ -137,192 +612,423 @@ void GeometryPool::fill_instance_data(const std::vector<Ref<MultiMesh> *> &p_mes
 				ZoneValue(used_buffer_size);
 				buffer.resize(used_buffer_size);
 			}
+
+			is_full_upload[type] = p_meshes[type]->multimesh != uploaded_meshes[type];
+			uploaded_meshes[type] = p_meshes[type]->multimesh;
 		}
 
-		size_t last_added = 0;
 		{
-			ZoneScopedN("Fill buffer");
-			ZoneValue(visible_buffer.size());
-			auto w = buffer.ptrw();
+			ZoneScopedN("Get buffers pointers");
+			// ptrw() can copy the data, so it must be called before the tasks start.
+			float *buffers_write[INSTANCE_BUFFERS_COUNT] = {};
+			for (int type = 0; type < INSTANCE_BUFFERS_COUNT; type++) {
+				if (used_count[type]) {
+					buffers_write[type] = temp_instances_buffers[type].ptrw();
+				}
+			}
 
-			for (auto &inst : visible_buffer) {
-				memcpy(w + last_added++ * INSTANCE_DATA_FLOAT_COUNT, reinterpret_cast<const real_t *>(&inst->data), INSTANCE_DATA_FLOAT_COUNT * sizeof(real_t));
+			for (size_t i = 0; i < task_count; i++) {
+				for (auto &o : instances_fill_tasks[i].outputs) {
+					o.buffer_write = buffers_write[o.type] ? buffers_write[o.type] + o.buffer_offset * INSTANCE_DATA_FLOAT_COUNT : nullptr;
+				}
 			}
 		}
 
-		// resize if the buffer size has changed.
-		auto &mesh = *p_meshes[type];
-		int32_t new_inst_count = (int)(buffer.size() / INSTANCE_DATA_FLOAT_COUNT);
-		if (new_inst_count != mesh->get_instance_count()) {
-			ZoneScopedN("Changing amount of instances");
-			ZoneValue(new_inst_count);
-			mesh->set_instance_count(new_inst_count);
+		{
+			ZoneScopedN("Fill buffers");
+			if (use_threads) {
+				group_task->run([this](int i) { _fill_instances_task(instances_fill_tasks[i]); }, (int)task_count, "DD3D instances buffers filling");
+			} else {
+				for (size_t i = 0; i < task_count; i++) {
+					_fill_instances_task(instances_fill_tasks[i]);
+				}
+			}
 		}
 
-		// just change the visible instances instead of resizing the entire buffer.
+		AABBMinMax visible_bounds[INSTANCE_BUFFERS_COUNT];
+		size_t changed_count[INSTANCE_BUFFERS_COUNT] = {};
 		{
-			int32_t new_visible_count = (int32_t)used_buffer_size / INSTANCE_DATA_FLOAT_COUNT;
-			ZoneScopedN("Set visible instances");
-			ZoneValue(new_visible_count);
-			mesh->set_visible_instance_count(new_visible_count);
+			ZoneScopedN("Merge bounds");
+			for (size_t i = 0; i < instances_fill_tasks.size(); i++) {
+				InstancesFillTask &task = instances_fill_tasks[i];
+				if (i >= task_count || !task.is_delayed) {
+					task.prev_arr = nullptr;
+				} else {
+					task.prev_arr = task.arr;
+					task.prev_delayed_slots = task.delayed_slots;
+					task.prev_relocations = task.pool->delayed_relocations;
+					task.prev_is_lod_split = task.is_lod_split;
+				}
+				if (i >= task_count) {
+					continue;
+				}
+
+				for (auto &o : task.outputs) {
+					visible_bounds[o.type].merge_with(o.bounds);
+					changed_count[o.type] += o.changed_count;
+					o.prev_type = o.type;
+					o.prev_buffer_offset = o.buffer_offset;
+				}
+			}
 		}
 
-		if (buffer.size()) {
-			ZoneScopedN("Set buffer");
-			mesh->set_buffer(buffer);
+		RenderingServer *rs = RenderingServer::get_singleton();
+		// Available since Godot 4.3. Otherwise the AABB is calculated by the engine over all instances.
+		static const bool has_custom_aabb = rs->has_method("multimesh_set_custom_aabb");
+
+		for (int type = 0; type < INSTANCE_BUFFERS_COUNT; type++) {
+			if (is_skipped[type]) {
+				continue;
+			}
+
+			ZoneScopedN("Set buffer iteration");
+			ZoneValue(type);
+			PackedFloat32Array &buffer = temp_instances_buffers[type];
+
+			// resize if the buffer size has changed.
+			MultiMeshBuffer &mesh = *p_meshes[type];
+			int32_t new_inst_count = (int)(buffer.size() / INSTANCE_DATA_FLOAT_COUNT);
+			if (new_inst_count != mesh.instance_count) {
+				ZoneScopedN("Changing amount of instances");
+				ZoneValue(new_inst_count);
+				rs->multimesh_allocate_data(mesh.multimesh, new_inst_count, RenderingServer::MULTIMESH_TRANSFORM_3D, true, true);
+				mesh.instance_count = new_inst_count;
+				// The server resets the state of the MultiMesh
+				mesh.visible_count = -1;
+				mesh.custom_aabb = AABB();
+				is_full_upload[type] = true;
+			}
+
+			// just change the visible instances instead of resizing the entire buffer.
+			int32_t new_visible_count = (int32_t)used_count[type];
+			if (new_visible_count != mesh.visible_count) {
+				ZoneScopedN("Set visible instances");
+				ZoneValue(new_visible_count);
+				rs->multimesh_set_visible_instances(mesh.multimesh, new_visible_count);
+				mesh.visible_count = new_visible_count;
+			}
+
+			if (!buffer.size()) {
+				continue;
+			}
+
+			// The custom AABB must be set before the data, so the engine does not calculate its own
+			if (has_custom_aabb && visible_count[type]) {
+				const AABBMinMax &b = visible_bounds[type];
+				AABB aabb(b.min, b.max - b.min);
+				if (aabb != mesh.custom_aabb) {
+					rs->call("multimesh_set_custom_aabb", mesh.multimesh, aabb);
+					mesh.custom_aabb = aabb;
+				}
+			}
+
+			if (!is_full_upload[type] && !changed_count[type]) {
+				continue;
+			}
+
+			// The server has no upload of a part of the buffer. The setters update only the changed regions of the MultiMesh,
+			// but each of them is a separate call, so a lot of changes are uploaded by the whole buffer once.
+			if (!is_full_upload[type] && changed_count[type] * INSTANCES_PARTIAL_UPLOAD_MAX_PART <= used_count[type]) {
+				ZoneScopedN("Set instances");
+				ZoneValue(changed_count[type]);
+				const GeometryPoolData3DInstance *instances = reinterpret_cast<const GeometryPoolData3DInstance *>(buffer.ptr());
+
+				for (size_t i = 0; i < task_count; i++) {
+					for (auto &o : instances_fill_tasks[i].outputs) {
+						if (o.type != type) {
+							continue;
+						}
+
+						for (auto &range : o.changed_ranges) {
+							for (size_t idx = range.start; idx < range.start + range.count; idx++) {
+								const GeometryPoolData3DInstance &d = instances[idx];
+								Transform3D xf;
+								xf.basis.rows[0] = d.basis_x;
+								xf.basis.rows[1] = d.basis_y;
+								xf.basis.rows[2] = d.basis_z;
+								xf.origin = Vector3(d.origin_x, d.origin_y, d.origin_z);
+
+								rs->multimesh_instance_set_transform(mesh.multimesh, (int32_t)idx, xf);
+								rs->multimesh_instance_set_color(mesh.multimesh, (int32_t)idx, d.color);
+								rs->multimesh_instance_set_custom_data(mesh.multimesh, (int32_t)idx, d.custom);
+							}
+						}
+					}
+				}
+			} else {
+				ZoneScopedN("Set buffer");
+				rs->multimesh_set_buffer(mesh.multimesh, buffer);
+			}
 		}
 	}
 
 	time_spent_to_fill_buffers_of_instances -= time_spent_to_cull_instances;
 }
 
-void GeometryPool::fill_lines_data(Ref<ArrayMesh> p_ig, std::unordered_map<Viewport *, std::shared_ptr<GeometryPoolCullingData> > &p_culling_data) {
+void GeometryPool::_update_lines_surface_capacity(const DepthTestMode &p_depth, Ref<ArrayMesh> &p_ig, const int64_t &p_used_vertexes) {
 	ZoneScoped;
+	LinesSurface &surface = lines_surfaces[(int)p_depth];
+
+	// The surface can be removed from outside
+	if (p_ig->get_surface_count() != 1) {
+		surface.capacity = 0;
+	}
+
+	int64_t new_capacity = surface.capacity;
+	if (p_used_vertexes > surface.capacity) {
+		new_capacity = p_used_vertexes + p_used_vertexes / 2;
+	} else if (surface.capacity > LINES_SURFACE_MIN_CAPACITY && p_used_vertexes < surface.capacity / 4) {
+		// shrink the surface only if it was used less than a quarter for some time
+		surface.time_used_less_then_quarter -= process_delta_sum;
+		if (surface.time_used_less_then_quarter <= 0) {
+			new_capacity = p_used_vertexes + p_used_vertexes / 2;
+		}
+	} else {
+		surface.time_used_less_then_quarter = TIME_USED_TO_SHRINK_INSTANT;
+	}
+	new_capacity = std::max(new_capacity, (int64_t)LINES_SURFACE_MIN_CAPACITY);
+	// the number of vertices must be even for the lines
+	new_capacity += new_capacity % 2;
+
+	if (new_capacity == surface.capacity) {
+		return;
+	}
+
+	ZoneScopedN("Recreate surface");
+	ZoneValue(new_capacity);
+	DEV_PRINT_STD("Recreating %s lines surface. From %d, to %d vertices\n", p_depth == DepthTestMode::NO_DEPTH ? "NoDepth" : "Normal", surface.capacity, new_capacity);
+
+	surface.time_used_less_then_quarter = TIME_USED_TO_SHRINK_INSTANT;
+	surface.capacity = new_capacity;
+	surface.written = 0;
+
+	// All vertices are at zero, so the unused lines have zero length and are not drawn.
+	PackedVector3Array vertexes;
+	PackedColorArray colors;
+	vertexes.resize(new_capacity);
+	colors.resize(new_capacity);
+
+	Array mesh = Array();
+	mesh.resize(ArrayMesh::ArrayType::ARRAY_MAX);
+	mesh[ArrayMesh::ArrayType::ARRAY_VERTEX] = vertexes;
+	mesh[ArrayMesh::ArrayType::ARRAY_COLOR] = colors;
+
+	p_ig->clear_surfaces();
+	p_ig->add_surface_from_arrays(Mesh::PrimitiveType::PRIMITIVE_LINES, mesh, Array(), Dictionary(), Mesh::ARRAY_FLAG_USE_DYNAMIC_UPDATE);
+
+	RenderingServer *rs = RenderingServer::get_singleton();
+	BitField<RenderingServer::ArrayFormat> format = RenderingServer::ARRAY_FORMAT_VERTEX | RenderingServer::ARRAY_FORMAT_COLOR;
+	surface.vertex_stride = rs->mesh_surface_get_format_vertex_stride(format, (int32_t)new_capacity);
+	surface.attribute_stride = rs->mesh_surface_get_format_attribute_stride(format, (int32_t)new_capacity);
+	surface.color_offset = rs->mesh_surface_get_format_offset(format, (int32_t)new_capacity, RenderingServer::ARRAY_COLOR);
+}
+
+void GeometryPool::fill_lines_data(const std::vector<Ref<ArrayMesh> *> &p_lines_meshes, std::unordered_map<Viewport *, std::shared_ptr<GeometryPoolCullingData> > &p_culling_data) {
+	ZoneScoped;
+
+	// reset timers
+	time_spent_to_cull_lines = 0;
+	time_spent_to_fill_buffers_of_lines = 0;
+
+	for (int depth_i = 0; depth_i < (int)DepthTestMode::MAX; depth_i++) {
+		if (p_lines_meshes[depth_i]) {
+			_fill_lines_surface((DepthTestMode)depth_i, *p_lines_meshes[depth_i], p_culling_data);
+		}
+	}
+
+	time_spent_to_fill_buffers_of_lines -= time_spent_to_cull_lines;
+}
+
+void GeometryPool::_fill_lines_surface(const DepthTestMode &p_depth, Ref<ArrayMesh> &p_ig, std::unordered_map<Viewport *, std::shared_ptr<GeometryPoolCullingData> > &p_culling_data) {
+	ZoneScoped;
+	LinesSurface &surface = lines_surfaces[(int)p_depth];
 
 	uint64_t used_lines = 0;
 	for (auto &vp_pool : pools) {
-		for (auto &proc : vp_pool.second) {
+		for (int proc_i = 0; proc_i < (int)ProcessType::MAX; proc_i++) {
+			auto &proc = vp_pool.second[_get_pools_index(p_depth, (ProcessType)proc_i)];
 			used_lines += proc.lines.used_instant;
 			used_lines += proc.lines.delayed.size();
 		}
 	}
 
-	if (used_lines == 0) {
+	// Nothing to draw and nothing to hide
+	if (used_lines == 0 && surface.written == 0) {
 		return;
 	}
 
-	GODOT_STOPWATCH(&time_spent_to_fill_buffers_of_lines);
+	GODOT_STOPWATCH_ADD(&time_spent_to_fill_buffers_of_lines);
 
-	size_t used_vertexes = 0;
-
-	PackedVector3Array vertexes;
-	PackedColorArray colors;
+	int64_t used_vertexes = 0;
+	size_t visible_count = 0;
+	size_t culled_small = 0;
 
-	std::vector<DelayedRendererLine *> visible_buffer;
+	std::vector<VisibleRange<GeometryPoolDataLines> > visible_ranges;
+	std::vector<uint32_t> visibility_mask;
 
 	{
 		ZoneScopedN("Prepare buffers");
-		visible_buffer.reserve(prev_buffer_visible_lines_count);
+		visible_ranges.reserve(surface.prev_visible_count);
 
 		{
 			ZoneScopedN("Update visibility and expiration");
-			GODOT_STOPWATCH(&time_spent_to_cull_lines);
-
-			// pre calculate buffer size
+			GODOT_STOPWATCH_ADD(&time_spent_to_cull_lines);
 
 			for (auto &vp_pool : pools) {
-				auto &culling_data = p_culling_data[vp_pool.first];
+				const GeometryPoolCullingData *culling_data = p_culling_data[vp_pool.first].get();
 
 				for (int proc_i = 0; proc_i < (int)ProcessType::MAX; proc_i++) {
-					auto &proc = vp_pool.second[proc_i];
-
-					for (size_t i = 0; i < proc.lines.used_instant; i++) {
-						auto &o = proc.lines.instant[i];
-						if (o.update_visibility(culling_data)) {
-							o.is_used_one_time = true;
-							used_vertexes += o.lines_count;
-							visible_buffer.push_back(&o);
-						}
-					}
+					auto &lines = vp_pool.second[_get_pools_index(p_depth, (ProcessType)proc_i)].lines;
 
-					proc.lines.used_delayed = 0;
-					if (proc_i == (int)ProcessType::PHYSICS_PROCESS) {
-						for (auto &o : proc.lines.delayed) {
-							if (!o.is_expired()) {
-								if (o.is_used_one_time) {
-									o.expiration_time -= physics_delta_sum;
-								}
-								o.is_used_one_time = true;
-								proc.lines.used_delayed++;
+					auto &inst_arr = lines.instant;
+					visible_count += cull_objects(culling_data, inst_arr.bounds.data(), inst_arr.states.data(), inst_arr.data.data(), lines.used_instant, visibility_mask, visible_ranges, &culled_small);
 
-								if (o.update_visibility(culling_data)) {
-									used_vertexes += o.lines_count;
-									visible_buffer.push_back(&o);
-								}
-							}
-						}
-					} else {
-						for (auto &o : proc.lines.delayed) {
-							if (!o.is_expired()) {
-								o.expiration_time -= process_delta_sum;
-								o.is_used_one_time = true;
-								proc.lines.used_delayed++;
-
-								if (o.update_visibility(culling_data)) {
-									used_vertexes += o.lines_count;
-									visible_buffer.push_back(&o);
-								}
-							}
-						}
-					}
+					lines.update_delayed_expiration(proc_i == (int)ProcessType::PHYSICS_PROCESS ? physics_time : process_time);
+					visible_count += lines.cull_delayed(culling_data, visibility_mask, visible_ranges, nullptr, &culled_small);
+				}
+			}
+
+			// pre calculate buffer size
+			for (const auto &range : visible_ranges) {
+				for (size_t i = 0; i < range.count; i++) {
+					used_vertexes += range.data[i].lines_count;
 				}
 			}
 		}
 
-		stat_visible_lines = visible_buffer.size();
-		prev_buffer_visible_lines_count = visible_buffer.size();
+		stat_visible_lines += visible_count;
+		stat_culled_small_lines += culled_small;
+		surface.prev_visible_count = visible_ranges.size();
 
 		ZoneValue(used_vertexes);
-		vertexes.resize(used_vertexes);
-		colors.resize(used_vertexes);
+		_update_lines_surface_capacity(p_depth, p_ig, used_vertexes);
 	}
 
-	size_t prev_pos = 0;
-	auto vertexes_write = vertexes.ptrw();
-	auto colors_write = colors.ptrw();
+	// The previously written vertices must be cleared if they are not overwritten now.
+	int64_t upload_count = std::max(used_vertexes, surface.written);
+	if (upload_count == 0) {
+		return;
+	}
 
+	AABBMinMax visible_bounds;
 	{
 		ZoneScopedN("Fill buffers");
-		ZoneValue(visible_buffer.size());
+		ZoneValue(visible_count);
 
-		for (const auto &o : visible_buffer) {
-			size_t lines_size = o->lines_count;
-			memcpy(vertexes_write + prev_pos, o->lines.get(), o->lines_count * sizeof(Vector3));
-			std::fill(colors_write + prev_pos, colors_write + prev_pos + lines_size, o->color);
-			prev_pos += lines_size;
+		if (surface.temp_vertex_buffer.size() != upload_count * surface.vertex_stride) {
+			surface.temp_vertex_buffer.resize(upload_count * surface.vertex_stride);
+		}
+		if (surface.temp_attribute_buffer.size() != upload_count * surface.attribute_stride) {
+			surface.temp_attribute_buffer.resize(upload_count * surface.attribute_stride);
 		}
-	}
 
-	if (used_vertexes > 1) {
-		ZoneScopedN("Set mesh arrays");
+		uint8_t *vertexes_write = surface.temp_vertex_buffer.ptrw();
+		uint8_t *attributes_write = surface.temp_attribute_buffer.ptrw() + surface.color_offset;
+
+		for (const auto &range : visible_ranges) {
+			for (size_t i = 0; i < range.count; i++) {
+				const auto &o = range.data[i];
+				const Vector3 *lines = o.get_lines();
+
+				// Colors are stored as RGBA8 in the attribute stream
+				const uint8_t color8[4] = {
+					(uint8_t)Math::clamp(o.color.r * 255.0f, 0.0f, 255.0f),
+					(uint8_t)Math::clamp(o.color.g * 255.0f, 0.0f, 255.0f),
+					(uint8_t)Math::clamp(o.color.b * 255.0f, 0.0f, 255.0f),
+					(uint8_t)Math::clamp(o.color.a * 255.0f, 0.0f, 255.0f),
+				};
+
+				for (size_t v = 0; v < o.lines_count; v++) {
+					const float pos[3] = { (float)lines[v].x, (float)lines[v].y, (float)lines[v].z };
+					memcpy(vertexes_write, pos, sizeof(pos));
+					memcpy(attributes_write, color8, sizeof(color8));
+					vertexes_write += surface.vertex_stride;
+					attributes_write += surface.attribute_stride;
+				}
+
+				visible_bounds.merge_with(range.bounds[i]);
+			}
+		}
 
-		Array mesh = Array();
-		mesh.resize(ArrayMesh::ArrayType::ARRAY_MAX);
-		mesh[ArrayMesh::ArrayType::ARRAY_VERTEX] = vertexes;
-		mesh[ArrayMesh::ArrayType::ARRAY_COLOR] = colors;
+		// Hide the lines of the previous frame
+		if (upload_count > used_vertexes) {
+			memset(surface.temp_vertex_buffer.ptrw() + used_vertexes * surface.vertex_stride, 0, (upload_count - used_vertexes) * surface.vertex_stride);
+		}
+	}
 
-		p_ig->add_surface_from_arrays(Mesh::PrimitiveType::PRIMITIVE_LINES, mesh);
+	{
+		ZoneScopedN("Update surface");
+		p_ig->surface_update_vertex_region(0, 0, surface.temp_vertex_buffer);
+		p_ig->surface_update_attribute_region(0, 0, surface.temp_attribute_buffer);
+		p_ig->set_custom_aabb(used_vertexes ? AABB(visible_bounds.min, visible_bounds.max - visible_bounds.min) : AABB());
 	}
 
-	time_spent_to_fill_buffers_of_lines -= time_spent_to_cull_lines;
+	surface.written = used_vertexes;
 }
 
 void GeometryPool::reset_counter(const double &p_delta, const ProcessType &p_proc) {
 	ZoneScoped;
 	if (p_proc == ProcessType::MAX) {
 		for (auto &vp_pool : pools) {
-			for (auto &proc : vp_pool.second) {
+			for (int pools_i = 0; pools_i < POOLS_PER_VIEWPORT; pools_i++) {
+				auto &proc = vp_pool.second[pools_i];
+				int depth_i = pools_i / (int)ProcessType::MAX;
+				_check_instant_objects_removal(proc);
 				for (int i = 0; i < (int)InstanceType::MAX; i++) {
-					proc.instances[i].reset_counter(p_delta, i);
+					proc.instances[i].reset_counter(p_delta, _get_buffer_index((DepthTestMode)depth_i, i));
 				}
 				proc.lines.reset_counter(p_delta);
+				proc.lines_arena.reset();
 			}
 		}
 	} else {
 		for (auto &vp_pool : pools) {
-			auto &proc = vp_pool.second[(int)p_proc];
-			for (int i = 0; i < (int)InstanceType::MAX; i++) {
-				proc.instances[i].reset_counter(p_delta, i);
+			for (int depth_i = 0; depth_i < (int)DepthTestMode::MAX; depth_i++) {
+				auto &proc = vp_pool.second[_get_pools_index((DepthTestMode)depth_i, p_proc)];
+				_check_instant_objects_removal(proc);
+				for (int i = 0; i < (int)InstanceType::MAX; i++) {
+					proc.instances[i].reset_counter(p_delta, _get_buffer_index((DepthTestMode)depth_i, i));
+				}
+				proc.lines.reset_counter(p_delta);
+				proc.lines_arena.reset();
 			}
-			proc.lines.reset_counter(p_delta);
 		}
 	}
+	_update_used_bytes();
+}
+
+void GeometryPool::_check_instant_objects_removal(const processTypePools &p_proc) {
+	// The removed instant objects must be hidden in the next frame
+	for (auto &i : p_proc.instances) {
+		if (i.used_instant) {
+			objects_generation++;
+			return;
+		}
+	}
+	if (p_proc.lines.used_instant) {
+		objects_generation++;
+	}
+}
+
+void GeometryPool::force_next_fill() {
+	objects_generation++;
+}
+
+void GeometryPool::reset_lines_surfaces() {
+	for (auto &surface : lines_surfaces) {
+		surface.capacity = 0;
+		surface.written = 0;
+		surface.prev_visible_count = 0;
+		surface.time_used_less_then_quarter = 0;
+	}
 }
 
 void GeometryPool::reset_visible_objects() {
 	ZoneScoped;
 	stat_visible_instances = 0;
 	stat_visible_lines = 0;
+	stat_culled_small_instances = 0;
+	stat_culled_small_lines = 0;
 }
 
 void GeometryPool::set_stats(Ref<DebugDraw3DStats> &p_stats) const {
@@ -334,8 +1040,9 @@ void GeometryPool::set_stats(Ref<DebugDraw3DStats> &p_stats) const {
 	} counts[(int)ProcessType::MAX];
 
 	for (auto &vp_pool : pools) {
-		for (int proc_i = 0; proc_i < (int)ProcessType::MAX; proc_i++) {
-			auto &proc = vp_pool.second[proc_i];
+		for (int pools_i = 0; pools_i < POOLS_PER_VIEWPORT; pools_i++) {
+			auto &proc = vp_pool.second[pools_i];
+			int proc_i = pools_i % (int)ProcessType::MAX;
 			for (auto &i : proc.instances) {
 				counts[proc_i].used_instances += i._prev_used_instant;
 				counts[proc_i].used_instances += i.used_delayed;
@@ -361,7 +1068,17 @@ void GeometryPool::set_stats(Ref<DebugDraw3DStats> &p_stats) const {
 			/* t_time_filling_buffers_lines_usec */ time_spent_to_fill_buffers_of_lines,
 
 			/* t_time_culling_instances_usec */ time_spent_to_cull_instances,
-			/* t_time_culling_lines_usec */ time_spent_to_cull_lines);
+			/* t_time_culling_lines_usec */ time_spent_to_cull_lines,
+
+			/* t_culled_small_instances */ stat_culled_small_instances,
+			/* t_culled_small_lines */ stat_culled_small_lines,
+
+			/* t_evicted_objects */ stat_evicted_objects,
+			/* t_rejected_objects */ stat_rejected_objects,
+
+			/* t_deduplicated_objects */ stat_deduplicated_objects,
+
+			/* t_skipped_frames */ stat_skipped_frames);
 }
 
 void GeometryPool::clear_pool() {
@@ -372,37 +1089,46 @@ void GeometryPool::clear_pool() {
 				i.clear_pools();
 			}
 			proc.lines.clear_pools();
+			proc.lines_arena.clear();
 		}
 	}
+	used_bytes = 0;
+	objects_generation++;
+
+	// The MultiMeshes can be released together with the objects
+	for (int type = 0; type < INSTANCE_BUFFERS_COUNT; type++) {
+		uploaded_meshes[type] = RID();
+		prev_buffer_visible_instance_count[type] = 0;
+	}
 }
 
-void GeometryPool::for_each_instance(const std::function<void(DelayedRendererInstance *)> &p_func) {
+void GeometryPool::for_each_instance(const std::function<void(const DelayedRenderer &, const AABBMinMax &)> &p_func) {
 	ZoneScoped;
 	for (auto &vp_pool : pools) {
 		for (auto &proc : vp_pool.second) {
 			for (auto &inst : proc.instances) {
 				for (size_t i = 0; i < inst.used_instant; i++) {
-					p_func(&inst.instant[i]);
+					p_func(inst.instant.states[i], inst.instant.bounds[i]);
 				}
 				for (size_t i = 0; i < inst.delayed.size(); i++) {
-					if (!inst.delayed[i].is_expired())
-						p_func(&inst.delayed[i]);
+					if (!inst.delayed.states[i].is_expired())
+						p_func(inst.delayed.states[i], inst.delayed.bounds[i]);
 				}
 			}
 		}
 	}
 }
 
-void GeometryPool::for_each_line(const std::function<void(DelayedRendererLine *)> &p_func) {
+void GeometryPool::for_each_line(const std::function<void(const DelayedRenderer &, const AABBMinMax &)> &p_func) {
 	ZoneScoped;
 	for (auto &vp_pool : pools) {
 		for (auto &proc : vp_pool.second) {
 			for (size_t i = 0; i < proc.lines.used_instant; i++) {
-				p_func(&proc.lines.instant[i]);
+				p_func(proc.lines.instant.states[i], proc.lines.instant.bounds[i]);
 			}
 			for (size_t i = 0; i < proc.lines.delayed.size(); i++) {
-				if (!proc.lines.delayed[i].is_expired())
-					p_func(&proc.lines.delayed[i]);
+				if (!proc.lines.delayed.states[i].is_expired())
+					p_func(proc.lines.delayed.states[i], proc.lines.delayed.bounds[i]);
 			}
 		}
 	}
@@ -418,6 +1144,14 @@ void GeometryPool::update_expiration_delta(const double &p_delta, const ProcessT
 	}
 }
 
+double GeometryPool::_get_expiration_time(const ProcessType &p_proc, const real_t &p_exp_time) {
+	// The time accumulated since the last rendering is included, so the object will be visible for at least `p_exp_time`.
+	if (p_proc == ProcessType::PHYSICS_PROCESS) {
+		return physics_time + physics_delta_sum + p_exp_time;
+	}
+	return process_time + process_delta_sum + p_exp_time;
+}
+
 bool GeometryPool::_is_viewport_empty(Viewport *vp) {
 	for (auto &proc : pools[vp]) {
 		for (auto &i : proc.instances) {
@@ -432,8 +1166,96 @@ bool GeometryPool::_is_viewport_empty(Viewport *vp) {
 	return true;
 }
 
-void GeometryPool::set_no_depth_test_info(bool p_no_depth_test) {
-	is_no_depth_test = p_no_depth_test;
+void GeometryPool::set_limits(const GeometryPoolLimits &p_limits) {
+	if (limits == p_limits)
+		return;
+	limits = p_limits;
+
+	bool track = limits.is_limited() && limits.eviction_policy == EvictionPolicy::OLDEST_FIRST;
+	for (auto &vp_pool : pools) {
+		for (auto &proc : vp_pool.second) {
+			for (auto &i : proc.instances) {
+				i.track_insertion_order = track;
+				if (!track) {
+					i.insertion_queue.clear();
+				}
+			}
+			proc.lines.track_insertion_order = track;
+			if (!track) {
+				proc.lines.insertion_queue.clear();
+			}
+		}
+	}
+}
+
+void GeometryPool::set_deduplication(bool p_enabled) {
+	if (use_deduplication == p_enabled)
+		return;
+	use_deduplication = p_enabled;
+
+	if (!use_deduplication) {
+		for (auto &vp_pool : pools) {
+			for (auto &proc : vp_pool.second) {
+				for (auto &i : proc.instances) {
+					i.frame_objects.clear();
+				}
+				proc.lines.frame_objects.clear();
+			}
+		}
+	}
+}
+
+void GeometryPool::_update_used_bytes() {
+	used_bytes = 0;
+	for (auto &vp_pool : pools) {
+		for (auto &proc : vp_pool.second) {
+			for (auto &i : proc.instances) {
+				used_bytes += i.get_used_bytes();
+			}
+			used_bytes += proc.lines.get_used_bytes();
+		}
+	}
+}
+
+template <class TData>
+bool GeometryPool::_make_room(ObjectsPool<TData> &p_pool, const size_t &p_max_objects, const size_t &p_new_bytes) {
+	p_pool.track_insertion_order = limits.eviction_policy == EvictionPolicy::OLDEST_FIRST;
+
+	while ((p_max_objects && p_pool.used_instant + p_pool.used_delayed >= p_max_objects) || (limits.max_bytes && used_bytes + p_new_bytes > limits.max_bytes)) {
+		if (limits.eviction_policy == EvictionPolicy::REJECT_NEW) {
+			return false;
+		}
+
+		size_t freed = p_pool.evict_delayed(limits.eviction_policy);
+		if (!freed && !(p_max_objects && p_pool.used_instant + p_pool.used_delayed >= p_max_objects)) {
+			freed = _evict_from_any_pool();
+		}
+		if (!freed) {
+			return false;
+		}
+		used_bytes -= std::min(used_bytes, freed);
+		frame_evicted_objects++;
+		objects_generation++;
+	}
+	used_bytes += p_new_bytes;
+	return true;
+}
+
+size_t GeometryPool::_evict_from_any_pool() {
+	ZoneScoped;
+	for (auto &vp_pool : pools) {
+		for (auto &proc : vp_pool.second) {
+			for (auto &i : proc.instances) {
+				if (i.used_delayed) {
+					return i.evict_delayed(limits.eviction_policy);
+				}
+			}
+			if (proc.lines.used_delayed) {
+				return proc.lines.evict_delayed(limits.eviction_policy);
+			}
+		}
+	}
+	return 0;
 }
 
 std::vector<Viewport *> GeometryPool::get_and_validate_viewports() {
@@ -444,7 +1266,7 @@ std::vector<Viewport *> GeometryPool::get_and_validate_viewports() {
 	for (const auto &vp : viewport_ids) {
 		if (UtilityFunctions::is_instance_id_valid(vp.second)) {
 			if (_is_viewport_empty(vp.first)) {
-				DEV_PRINT_STD("%s Viewport (%s) did not contain any debug data,\n\tit will be deleted from the World3D's container.\n", is_no_depth_test ? "NoDepth" : "Normal", vp.first->to_string().utf8().get_data());
+				DEV_PRINT_STD("Viewport (%s) did not contain any debug data,\n\tit will be deleted from the World3D's container.\n", vp.first->to_string().utf8().get_data());
 				to_delete.push_back(vp.first);
 			} else {
 				res.push_back(vp.first);
@@ -457,6 +1279,7 @@ std::vector<Viewport *> GeometryPool::get_and_validate_viewports() {
 	for (const auto &vp : to_delete) {
 		viewport_ids.erase(vp);
 		pools.erase(vp);
+		pools_layout_version++;
 	}
 
 	return res;
@@ -469,33 +1292,250 @@ void GeometryPool::add_or_update_instance(const std::shared_ptr<DebugDraw3DScope
 
 void GeometryPool::add_or_update_instance(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg, InstanceType p_type, const real_t &p_exp_time, const ProcessType &p_proc, const Transform3D &p_transform, const Color &p_col, const SphereBounds &p_bounds, const Color *p_custom_col) {
 	ZoneScoped;
-	auto &proc = pools[p_cfg->dcd.viewport][(int)p_proc];
-	DelayedRendererInstance *inst = proc.instances[(int)p_type].get(p_exp_time > 0);
-	viewport_ids[p_cfg->dcd.viewport] = p_cfg->dcd.viewport->get_instance_id();
+	size_t pools_count = pools.size();
+	auto &proc = pools[p_cfg->dcd.viewport][_get_pools_index(p_cfg->dcd.no_depth_test ? DepthTestMode::NO_DEPTH : DepthTestMode::NORMAL, p_proc)];
+	if (pools_count != pools.size()) {
+		pools_layout_version++;
+	}
+
+	bool is_delayed = p_exp_time > 0;
+	double exp_time = is_delayed ? _get_expiration_time(p_proc, p_exp_time) : 0;
+	auto &pool = proc.instances[(int)p_type];
+	GeometryPoolData3DInstance data(p_transform, p_col, p_custom_col ? *p_custom_col : _scoped_config_to_custom(p_cfg));
+
+	uint64_t hash = 0;
+	if (use_deduplication) {
+		hash = _get_instance_hash(data);
+		if (pool.find_frame_duplicate(hash, is_delayed, exp_time, [&data](const GeometryPoolData3DInstance &o) { return o.is_equal(data); })) {
+			frame_deduplicated_objects++;
+			return;
+		}
+	}
+
+	if (limits.is_limited() && !_make_room(pool, limits.max_instances_per_type, pool.OBJECT_BYTES)) {
+		frame_rejected_objects++;
+		return;
+	}
+
+	auto &arr = is_delayed ? pool.delayed : pool.instant;
+	size_t idx = pool.get(is_delayed);
+	viewport_ids[p_cfg->dcd.viewport] = p_cfg->dcd.viewport_id;
+	objects_generation++;
 
 	SphereBounds thick_sphere = p_bounds;
 	thick_sphere.radius += p_cfg->thickness * 0.5f;
 
-	inst->data = GeometryPoolData3DInstance(p_transform, p_col, p_custom_col ? *p_custom_col : _scoped_config_to_custom(p_cfg));
-	inst->bounds = thick_sphere;
-	inst->expiration_time = p_exp_time;
-	inst->is_used_one_time = false;
-	inst->is_visible = true;
+	arr.data[idx] = data;
+	arr.bounds[idx] = thick_sphere;
+
+	DelayedRenderer &state = arr.states[idx];
+	state.is_visible = false;
+	state.is_dirty = true;
+
+	if (is_delayed) {
+		pool.set_delayed_expiration(idx, exp_time);
+		pool.update_delayed_leaf(idx);
+	}
+
+	if (use_deduplication) {
+		pool.add_frame_object(hash, is_delayed, idx, exp_time);
+	}
 }
 
-void GeometryPool::add_or_update_line(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg, const real_t &p_exp_time, const ProcessType &p_proc, std::unique_ptr<Vector3[]> p_lines, const size_t p_line_count, const Color &p_col) {
+void GeometryPool::add_or_update_instances(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg, ConvertableInstanceType p_type, const real_t &p_exp_time, const ProcessType &p_proc, const Transform3D *p_transforms, const Color *p_colors, const SphereBounds *p_bounds, const size_t &p_count, const Color *p_custom_col) {
 	ZoneScoped;
-	auto &proc = pools[p_cfg->dcd.viewport][(int)p_proc];
-	DelayedRendererLine *inst = proc.lines.get(p_exp_time > 0);
-	viewport_ids[p_cfg->dcd.viewport] = p_cfg->dcd.viewport->get_instance_id();
+	add_or_update_instances(p_cfg, _scoped_config_type_convert(p_type, p_cfg), p_exp_time, p_proc, p_transforms, p_colors, p_bounds, p_count, p_custom_col);
+}
+
+void GeometryPool::add_or_update_instances(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg, InstanceType p_type, const real_t &p_exp_time, const ProcessType &p_proc, const Transform3D *p_transforms, const Color *p_colors, const SphereBounds *p_bounds, const size_t &p_count, const Color *p_custom_col) {
+	ZoneScoped;
+	if (!p_count) {
+		return;
+	}
+
+	size_t pools_count = pools.size();
+	auto &proc = pools[p_cfg->dcd.viewport][_get_pools_index(p_cfg->dcd.no_depth_test ? DepthTestMode::NO_DEPTH : DepthTestMode::NORMAL, p_proc)];
+	if (pools_count != pools.size()) {
+		pools_layout_version++;
+	}
+	viewport_ids[p_cfg->dcd.viewport] = p_cfg->dcd.viewport_id;
+
+	// Everything that is common for the batch is resolved only once
+	bool is_delayed = p_exp_time > 0;
+	auto &pool = proc.instances[(int)p_type];
+	auto &arr = is_delayed ? pool.delayed : pool.instant;
+	bool is_limited = limits.is_limited();
+	pool.reserve(is_delayed, is_limited && limits.max_instances_per_type ? std::min(p_count, limits.max_instances_per_type) : p_count);
+
+	const Color custom_col = p_custom_col ? *p_custom_col : _scoped_config_to_custom(p_cfg);
+	const real_t thickness_radius = p_cfg->thickness * 0.5f;
+	const double exp_time = is_delayed ? _get_expiration_time(p_proc, p_exp_time) : 0;
+
+	for (size_t i = 0; i < p_count; i++) {
+		GeometryPoolData3DInstance data(p_transforms[i], p_colors[i], custom_col);
+
+		uint64_t hash = 0;
+		if (use_deduplication) {
+			hash = _get_instance_hash(data);
+			if (pool.find_frame_duplicate(hash, is_delayed, exp_time, [&data](const GeometryPoolData3DInstance &o) { return o.is_equal(data); })) {
+				frame_deduplicated_objects++;
+				continue;
+			}
+		}
+
+		if (is_limited && !_make_room(pool, limits.max_instances_per_type, pool.OBJECT_BYTES)) {
+			frame_rejected_objects += p_count - i;
+			break;
+		}
+		size_t idx = pool.get(is_delayed);
+		objects_generation++;
+
+		arr.data[idx] = data;
+		arr.bounds[idx] = SphereBounds(p_bounds[i].position, p_bounds[i].radius + thickness_radius);
 
-	inst->lines = std::move(p_lines);
-	inst->lines_count = p_line_count;
-	inst->color = p_col;
-	inst->bounds = MathUtils::calculate_vertex_bounds(inst->lines.get(), p_line_count);
-	inst->expiration_time = p_exp_time;
-	inst->is_used_one_time = false;
-	inst->is_visible = true;
+		DelayedRenderer &state = arr.states[idx];
+		state.is_visible = false;
+		state.is_dirty = true;
+
+		if (is_delayed) {
+			pool.set_delayed_expiration(idx, exp_time);
+			pool.update_delayed_leaf(idx);
+		}
+
+		if (use_deduplication) {
+			pool.add_frame_object(hash, is_delayed, idx, exp_time);
+		}
+	}
+}
+
+void GeometryPool::add_or_update_line(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg, const real_t &p_exp_time, const ProcessType &p_proc, const Vector3 *p_lines, const size_t p_line_count, const Color &p_col, const std::shared_ptr<const std::vector<Vector3> > &p_owner) {
+	ZoneScoped;
+	if (p_line_count == 0) {
+		return;
+	}
+
+	size_t pools_count = pools.size();
+	auto &proc = pools[p_cfg->dcd.viewport][_get_pools_index(p_cfg->dcd.no_depth_test ? DepthTestMode::NO_DEPTH : DepthTestMode::NORMAL, p_proc)];
+	if (pools_count != pools.size()) {
+		pools_layout_version++;
+	}
+	viewport_ids[p_cfg->dcd.viewport] = p_cfg->dcd.viewport_id;
+
+	// Big batches of lines are split into chunks with their own bounds,
+	// so only the visible parts of them are copied to the surface.
+	double exp_time = p_exp_time > 0 ? _get_expiration_time(p_proc, p_exp_time) : 0;
+	size_t offset = 0;
+	while (offset < p_line_count) {
+		size_t chunk_count = std::min(p_line_count - offset, (size_t)LINES_CHUNK_MAX_VERTEXES);
+		_add_lines_chunk(proc, exp_time, p_lines + offset, chunk_count, p_col, p_owner);
+		offset += chunk_count;
+	}
+}
+
+void GeometryPool::_add_lines_chunk(processTypePools &p_proc, const double &p_exp_time, const Vector3 *p_lines, const size_t p_line_count, const Color &p_col, const std::shared_ptr<const std::vector<Vector3> > &p_owner) {
+	bool is_delayed = p_exp_time > 0;
+
+	uint64_t hash = 0;
+	if (use_deduplication) {
+		hash = _get_lines_hash(p_lines, p_line_count, p_col);
+		if (p_proc.lines.find_frame_duplicate(hash, is_delayed, p_exp_time, [&](const GeometryPoolDataLines &o) { return o.is_equal(p_lines, p_line_count, p_col); })) {
+			frame_deduplicated_objects++;
+			return;
+		}
+	}
+
+	size_t payload_bytes = p_line_count > 2 ? p_line_count * sizeof(Vector3) : 0;
+	if (limits.is_limited() && !_make_room(p_proc.lines, limits.max_lines, p_proc.lines.OBJECT_BYTES + payload_bytes)) {
+		frame_rejected_objects++;
+		return;
+	}
+
+	auto &arr = is_delayed ? p_proc.lines.delayed : p_proc.lines.instant;
+	size_t idx = p_proc.lines.get(is_delayed);
+	objects_generation++;
+
+	GeometryPoolDataLines &line = arr.data[idx];
+	if (p_line_count <= 2) {
+		std::copy(p_lines, p_lines + p_line_count, line.inline_lines);
+	} else if (is_delayed) {
+		if (line.owned_capacity < p_line_count) {
+			line.owned_lines = std::unique_ptr<Vector3[]>(new Vector3[p_line_count]);
+			line.owned_capacity = p_line_count;
+		}
+		memcpy(line.owned_lines.get(), p_lines, p_line_count * sizeof(Vector3));
+		line.external_lines = line.owned_lines.get();
+	} else if (p_owner) {
+		// Instant lines live only until the arena is reset, so the buffer of the caller can be used directly
+		p_proc.lines_arena.adopt(p_owner);
+		line.external_lines = p_lines;
+	} else {
+		Vector3 *lines = p_proc.lines_arena.alloc(p_line_count);
+		memcpy(lines, p_lines, p_line_count * sizeof(Vector3));
+		line.external_lines = lines;
+	}
+
+	line.lines_count = p_line_count;
+	line.color = p_col;
+	p_proc.lines.add_payload_bytes(is_delayed, payload_bytes);
+	arr.bounds[idx] = MathUtils::calculate_vertex_bounds(p_lines, p_line_count);
+
+	DelayedRenderer &state = arr.states[idx];
+	state.is_visible = false;
+	state.is_dirty = true;
+
+	if (is_delayed) {
+		p_proc.lines.set_delayed_expiration(idx, p_exp_time);
+		p_proc.lines.update_delayed_leaf(idx);
+	}
+
+	if (use_deduplication) {
+		p_proc.lines.add_frame_object(hash, is_delayed, idx, p_exp_time);
+	}
+}
+
+static _FORCE_INLINE_ uint64_t _hash_mix(const uint64_t &p_hash, const uint64_t &p_value) {
+	return p_hash ^ (p_value + 0x9e3779b97f4a7c15ull + (p_hash << 6) + (p_hash >> 2));
+}
+
+static _FORCE_INLINE_ uint64_t _hash_real(const uint64_t &p_hash, const real_t &p_value) {
+	// The duplicates are compared exactly, so the bits are hashed as is. Only -0 is converted, because it is equal to 0.
+	double value = p_value == 0 ? 0.0 : (double)p_value;
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return _hash_mix(p_hash, bits);
+}
+
+static _FORCE_INLINE_ uint64_t _hash_vector3(uint64_t p_hash, const Vector3 &p_value) {
+	p_hash = _hash_real(p_hash, p_value.x);
+	p_hash = _hash_real(p_hash, p_value.y);
+	return _hash_real(p_hash, p_value.z);
+}
+
+static _FORCE_INLINE_ uint64_t _hash_color(uint64_t p_hash, const Color &p_value) {
+	p_hash = _hash_real(p_hash, p_value.r);
+	p_hash = _hash_real(p_hash, p_value.g);
+	p_hash = _hash_real(p_hash, p_value.b);
+	return _hash_real(p_hash, p_value.a);
+}
+
+uint64_t GeometryPool::_get_instance_hash(const GeometryPoolData3DInstance &p_data) {
+	// The type of the instance is defined by its pool
+	uint64_t hash = 0;
+	hash = _hash_vector3(hash, p_data.basis_x);
+	hash = _hash_vector3(hash, p_data.basis_y);
+	hash = _hash_vector3(hash, p_data.basis_z);
+	hash = _hash_vector3(hash, Vector3(p_data.origin_x, p_data.origin_y, p_data.origin_z));
+	hash = _hash_color(hash, p_data.color);
+	return _hash_color(hash, p_data.custom);
+}
+
+uint64_t GeometryPool::_get_lines_hash(const Vector3 *p_lines, const size_t &p_line_count, const Color &p_col) {
+	uint64_t hash = _hash_mix(0, p_line_count);
+	hash = _hash_color(hash, p_col);
+	for (size_t i = 0; i < p_line_count; i++) {
+		hash = _hash_vector3(hash, p_lines[i]);
+	}
+	return hash;
 }
 
 GeometryType GeometryPool::_scoped_config_get_geometry_type(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg) {
@@ -507,6 +1547,46 @@ GeometryType GeometryPool::_scoped_config_get_geometry_type(const std::shared_pt
 	return GeometryType::Wireframe;
 }
 
+InstanceType GeometryPool::_get_lod_type(const InstanceType &p_type, const InstanceLOD &p_lod) {
+	switch (p_lod) {
+		case InstanceLOD::LOW: {
+			switch (p_type) {
+				case InstanceType::SPHERE:
+				case InstanceType::SPHERE_HD:
+					return InstanceType::SPHERE_LD;
+				case InstanceType::CYLINDER:
+					return InstanceType::CYLINDER_LD;
+				case InstanceType::CYLINDER_AB:
+					return InstanceType::CYLINDER_AB_LD;
+				case InstanceType::SPHERE_VOLUMETRIC:
+				case InstanceType::SPHERE_HD_VOLUMETRIC:
+					return InstanceType::SPHERE_LD_VOLUMETRIC;
+				case InstanceType::CYLINDER_VOLUMETRIC:
+					return InstanceType::CYLINDER_LD_VOLUMETRIC;
+				case InstanceType::CYLINDER_AB_VOLUMETRIC:
+					return InstanceType::CYLINDER_AB_LD_VOLUMETRIC;
+				default:
+					break;
+			}
+			break;
+		}
+		case InstanceLOD::HIGH: {
+			switch (p_type) {
+				case InstanceType::SPHERE:
+					return InstanceType::SPHERE_HD;
+				case InstanceType::SPHERE_VOLUMETRIC:
+					return InstanceType::SPHERE_HD_VOLUMETRIC;
+				default:
+					break;
+			}
+			break;
+		}
+		default:
+			break;
+	}
+	return p_type;
+}
+
 Color GeometryPool::_scoped_config_to_custom(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg) {
 	// ZoneScoped;
 	if (_scoped_config_get_geometry_type(p_cfg) == GeometryType::Volumetric)
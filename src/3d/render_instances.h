@@ -4,11 +4,15 @@
 
 #include "config_scope_3d.h"
 #include "render_instances_enums.h"
+#include "utils/aabb_tree.h"
 #include "utils/math_utils.h"
 #include "utils/utils.h"
 
+#include <algorithm>
 #include <array>
+#include <deque>
 #include <functional>
+#include <unordered_map>
 #include <unordered_set>
 
 GODOT_WARNING_DISABLE()
@@ -16,19 +20,95 @@ GODOT_WARNING_DISABLE()
 GODOT_WARNING_RESTORE()
 using namespace godot;
 
-namespace godot {
-class MultiMesh;
-}
 class DebugDraw3DStats;
 class GeometryPool;
 
+/// @private
+/// Runs a function on the WorkerThreadPool. The Callable requires a bound method, so this object is used as a proxy.
+class _DD3D_GroupTask : public Object {
+	GDCLASS(_DD3D_GroupTask, Object)
+protected:
+	std::function<void(int)> m_func;
+	static void _bind_methods();
+
+public:
+	void _execute(int p_index);
+
+	/// Calls the function `p_count` times with the index of a call and waits for the completion of all calls.
+	void run(const std::function<void(int)> &p_func, const int &p_count, const String &p_description);
+};
+
+/// Camera data required to estimate the size of objects on the screen.
+struct GeometryPoolCamera {
+	Vector3 position;
+	// Converts the radius to the size relative to the height of the viewport.
+	// The result must be divided by the distance if the camera is not orthogonal.
+	real_t size_scale;
+	// Height of the viewport in pixels
+	real_t viewport_height;
+	bool is_orthogonal;
+
+	_FORCE_INLINE_ real_t get_screen_size(const AABBMinMax &p_bounds) const {
+		real_t s = p_bounds.radius * size_scale;
+		if (!is_orthogonal) {
+			s /= Math::max(position.distance_to(p_bounds.center), (real_t)CMP_EPSILON);
+		}
+		return s;
+	}
+};
+
 class GeometryPoolCullingData {
 public:
 	std::vector<std::array<Plane, 6> > m_frustums;
 	std::vector<AABBMinMax> m_frustum_boxes;
-	GeometryPoolCullingData(const std::vector<std::array<Plane, 6> > &p_frustums, const std::vector<AABBMinMax> p_frustum_boxes) {
+	std::vector<GeometryPoolCamera> m_cameras;
+	real_t m_lod_low_size;
+	real_t m_lod_high_size;
+	real_t m_min_pixel_radius;
+	GeometryPoolCullingData(const std::vector<std::array<Plane, 6> > &p_frustums, const std::vector<AABBMinMax> p_frustum_boxes, const std::vector<GeometryPoolCamera> &p_cameras = {}, const real_t &p_lod_low_size = 0, const real_t &p_lod_high_size = 0, const real_t &p_min_pixel_radius = 0) {
 		m_frustums = p_frustums;
 		m_frustum_boxes = p_frustum_boxes;
+		m_cameras = p_cameras;
+		m_lod_low_size = p_lod_low_size;
+		m_lod_high_size = p_lod_high_size;
+		m_min_pixel_radius = p_min_pixel_radius;
+	}
+
+	_FORCE_INLINE_ bool has_lod() const {
+		return m_cameras.size() && (m_lod_low_size > 0 || m_lod_high_size > 0);
+	}
+
+	/// Returns true if the culling with this data gives the same result.
+	bool is_equal(const GeometryPoolCullingData &p_other) const;
+
+	_FORCE_INLINE_ bool has_small_objects_culling() const {
+		return m_cameras.size() && m_min_pixel_radius > 0;
+	}
+
+	/// Returns true if the radius of an object on the screen is less than `m_min_pixel_radius` for all cameras.
+	_FORCE_INLINE_ bool is_too_small(const AABBMinMax &p_bounds) const {
+		for (const auto &cam : m_cameras) {
+			if (cam.get_screen_size(p_bounds) * cam.viewport_height * 0.5f >= m_min_pixel_radius) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/// Returns the LOD of an object by its largest size on the screen among all cameras.
+	_FORCE_INLINE_ InstanceLOD get_lod(const AABBMinMax &p_bounds) const {
+		real_t size = 0;
+		for (const auto &cam : m_cameras) {
+			size = Math::max(size, cam.get_screen_size(p_bounds));
+		}
+
+		if (m_lod_low_size > 0 && size < m_lod_low_size) {
+			return InstanceLOD::LOW;
+		}
+		if (m_lod_high_size > 0 && size > m_lod_high_size) {
+			return InstanceLOD::HIGH;
+		}
+		return InstanceLOD::NORMAL;
 	}
 };
 
@@ -61,45 +141,140 @@ struct GeometryPoolData3DInstance {
 			origin_z(p_xf.origin.z),
 			color(p_color),
 			custom(p_custom) {}
+
+	_FORCE_INLINE_ bool is_equal(const GeometryPoolData3DInstance &p_other) const {
+		return basis_x == p_other.basis_x && origin_x == p_other.origin_x &&
+			   basis_y == p_other.basis_y && origin_y == p_other.origin_y &&
+			   basis_z == p_other.basis_z && origin_z == p_other.origin_z &&
+			   color == p_other.color && custom == p_other.custom;
+	}
 };
 
-struct DelayedRenderer {
-	double expiration_time;
-	bool is_used_one_time;
-	bool is_visible;
-	AABBMinMax bounds;
+struct GeometryPoolDataLines {
+	// Lines with 2 points are stored here without any allocations.
+	Vector3 inline_lines[2];
+	// Points to the frame arena for instant lines or to `owned_lines` for delayed lines.
+	const Vector3 *external_lines;
+	// Storage of delayed lines. It is kept when the slot is reused, so it is reallocated only when it is too small.
+	std::unique_ptr<Vector3[]> owned_lines;
+	size_t owned_capacity;
+	size_t lines_count;
+	Color color;
 
-	DelayedRenderer() :
-			expiration_time(0),
-			is_used_one_time(true),
-			is_visible(false),
-			bounds() {}
+	GeometryPoolDataLines() :
+			external_lines(nullptr),
+			owned_capacity(0),
+			lines_count(0) {}
 
-	_FORCE_INLINE_ bool is_expired() const {
-		return expiration_time < 0 ? is_used_one_time : false;
+	_FORCE_INLINE_ const Vector3 *get_lines() const {
+		return lines_count <= 2 ? inline_lines : external_lines;
 	}
 
-	_FORCE_INLINE_ void update_viewport_expiration(const double &p_delta) {
-		if (!is_expired()) {
-			expiration_time -= p_delta;
-		}
+	_FORCE_INLINE_ bool is_equal(const Vector3 *p_lines, const size_t &p_count, const Color &p_color) const {
+		return lines_count == p_count && color == p_color && std::equal(p_lines, p_lines + p_count, get_lines());
 	}
+};
+
+/// Memory used by an object outside of the pool arrays.
+_FORCE_INLINE_ size_t get_payload_bytes(const GeometryPoolData3DInstance &) {
+	return 0;
+}
+
+_FORCE_INLINE_ size_t get_payload_bytes(const GeometryPoolDataLines &p_data) {
+	return p_data.lines_count > 2 ? p_data.lines_count * sizeof(Vector3) : 0;
+}
 
-	_FORCE_INLINE_ bool update_visibility(const std::shared_ptr<GeometryPoolCullingData> &p_culling_data);
+/// Limits of the objects stored in a GeometryPool. Zero means no limit.
+struct GeometryPoolLimits {
+	// For each type of instances in each viewport
+	size_t max_instances_per_type = 0;
+	// Lines or chunks of lines in each viewport
+	size_t max_lines = 0;
+	// Estimated memory of all objects
+	size_t max_bytes = 0;
+	EvictionPolicy eviction_policy = EvictionPolicy::OLDEST_FIRST;
+
+	_FORCE_INLINE_ bool is_limited() const {
+		return max_instances_per_type || max_lines || max_bytes;
+	}
+
+	bool operator==(const GeometryPoolLimits &p_other) const {
+		return max_instances_per_type == p_other.max_instances_per_type &&
+				max_lines == p_other.max_lines &&
+				max_bytes == p_other.max_bytes &&
+				eviction_policy == p_other.eviction_policy;
+	}
 };
 
-struct DelayedRendererInstance : public DelayedRenderer {
-	GeometryPoolData3DInstance data;
+/// Bump allocator for the points of instant lines.
+/// All allocations are released at once by `reset`, after which the memory is reused.
+class LinesArena {
+	enum : size_t {
+		MIN_BLOCK_SIZE = 4096,
+	};
+
+	struct Block {
+		std::unique_ptr<Vector3[]> data;
+		size_t size;
+	};
+
+	std::vector<Block> blocks;
+	// External buffers that are used instead of copying them to the blocks
+	std::vector<std::shared_ptr<const std::vector<Vector3> > > adopted;
+	size_t current_block = 0;
+	size_t used_in_block = 0;
+	size_t used_total = 0;
 
-	DelayedRendererInstance();
+public:
+	Vector3 *alloc(const size_t &p_count);
+	/// Keeps the buffer alive until the next `reset` or `clear`.
+	void adopt(const std::shared_ptr<const std::vector<Vector3> > &p_buffer);
+	void reset();
+	void clear();
 };
 
-struct DelayedRendererLine : public DelayedRenderer {
-	std::unique_ptr<Vector3[]> lines;
-	size_t lines_count;
-	Color color;
+template <class TData>
+struct VisibleRange {
+	const TData *data;
+	const AABBMinMax *bounds;
+	size_t count;
+};
+
+/// Expiration time and flags of the pool object.
+/// Bounds and payload are stored in the parallel arrays of GeometryPool::ObjectsArrays.
+struct DelayedRenderer {
+	// Absolute time on the clock of the process type of the pool
+	double expiration_time;
+	bool has_expired;
+	bool is_visible;
+	// The payload or bounds have been changed since the last culling
+	bool is_dirty;
+	// Visibility at the last culling
+	bool was_visible;
+	// LOD at the last culling
+	InstanceLOD lod;
+
+	DelayedRenderer() :
+			expiration_time(0),
+			has_expired(false),
+			is_visible(false),
+			is_dirty(false),
+			was_visible(false),
+			lod(InstanceLOD::NORMAL) {}
+
+	_FORCE_INLINE_ bool is_expired() const {
+		return has_expired;
+	}
+};
 
-	DelayedRendererLine();
+/// MultiMesh created directly in the RenderingServer.
+/// Its state is cached here, so it is never requested from the server.
+struct MultiMeshBuffer {
+	RID multimesh;
+	int32_t instance_count = 0;
+	// The server uses -1 to draw all instances
+	int32_t visible_count = -1;
+	AABB custom_aabb;
 };
 
 class GeometryPool {
@@ -109,17 +284,96 @@ private:
 		TIME_USED_TO_SHRINK_DELAYED = 5,
 	};
 
-	bool is_no_depth_test = false;
+	// Structure of arrays. The culling only reads `bounds`, the expiration only `states`,
+	// and the buffers are filled from the contiguous `data`.
+	template <class TData>
+	struct ObjectsArrays {
+		std::vector<AABBMinMax> bounds = {};
+		std::vector<DelayedRenderer> states = {};
+		std::vector<TData> data = {};
+
+		_FORCE_INLINE_ size_t size() const {
+			return states.size();
+		}
+
+		void push_back() {
+			bounds.emplace_back();
+			states.emplace_back();
+			data.emplace_back();
+		}
+
+		void reserve(const size_t &p_size) {
+			bounds.reserve(p_size);
+			states.reserve(p_size);
+			data.reserve(p_size);
+		}
 
-	template <class TInst>
+		void resize(const size_t &p_size) {
+			bounds.resize(p_size);
+			states.resize(p_size);
+			data.resize(p_size);
+		}
+
+		void move(const size_t &p_from, const size_t &p_to) {
+			bounds[p_to] = bounds[p_from];
+			states[p_to] = states[p_from];
+			data[p_to] = std::move(data[p_from]);
+		}
+
+		void clear() {
+			bounds.clear();
+			states.clear();
+			data.clear();
+		}
+	};
+
+	template <class TData>
 	struct ObjectsPool {
-		std::vector<TInst> instant = {};
-		std::vector<TInst> delayed = {};
+		enum : size_t {
+			OBJECT_BYTES = sizeof(TData) + sizeof(AABBMinMax) + sizeof(DelayedRenderer),
+		};
+
+		ObjectsArrays<TData> instant = {};
+		ObjectsArrays<TData> delayed = {};
+
+		// Spatial index of the alive delayed objects. Expired objects are removed from it.
+		AABBTree delayed_tree = {};
+		// Leaf of each delayed object in `delayed_tree` or -1
+		std::vector<int32_t> delayed_leaves = {};
+		// Bits of the delayed objects that were visible at the last culling
+		std::vector<uint32_t> delayed_prev_visible = {};
+		// Incremented when the slot of a delayed object is freed, so the entries of the previous objects are not used for the new one
+		std::vector<uint32_t> delayed_generations = {};
+
+		// Delayed objects ordered by expiration time.
+		// Entries of reused slots are skipped when their generation does not match, and entries of extended objects when their time does not match.
+		struct ExpirationEntry {
+			double time;
+			uint32_t idx;
+			uint32_t generation;
+
+			bool operator<(const ExpirationEntry &p_other) const {
+				// std::*_heap builds a max-heap
+				return time > p_other.time;
+			}
+		};
+		std::vector<ExpirationEntry> expiration_heap = {};
+		// Delayed objects in the order of addition. It is filled only if `track_insertion_order` is set.
+		std::deque<ExpirationEntry> insertion_queue = {};
+		bool track_insertion_order = false;
+		// Objects added in the current frame by their hash. It is filled only if the deduplication is enabled.
+		// All objects with the same hash are kept, so a collision does not hide the earlier object.
+		std::unordered_multimap<uint64_t, ExpirationEntry> frame_objects = {};
+		// Expired slots of `delayed` ready to be reused
+		std::vector<uint32_t> delayed_free_slots = {};
+		// Incremented when the delayed objects are moved to other slots or removed at once
+		uint32_t delayed_relocations = 0;
 
 		size_t used_instant = 0;
 		size_t used_delayed = 0;
+		size_t instant_payload_bytes = 0;
+		size_t delayed_payload_bytes = 0;
 		size_t _prev_used_instant = 0;
-		size_t _prev_not_expired_delayed = 0;
 		double time_used_less_then_half_of_instant_pool = 0;
 		double time_used_less_then_quarter_of_delayed_pool = 0;
 
@@ -128,36 +382,282 @@ private:
 			time_used_less_then_quarter_of_delayed_pool = TIME_USED_TO_SHRINK_DELAYED;
 		}
 
-		TInst *get(bool is_delayed) {
+		/// Returns the index of a free object in `instant` or `delayed`
+		size_t get(bool is_delayed) {
 			ZoneScoped;
-			auto objs = is_delayed ? &delayed : &instant;
-			auto used = is_delayed ? &_prev_not_expired_delayed : &used_instant;
+			if (is_delayed) {
+				used_delayed++;
+				if (delayed_free_slots.size()) {
+					size_t idx = delayed_free_slots.back();
+					delayed_free_slots.pop_back();
+					return idx;
+				}
+
+				delayed.push_back();
+				delayed_generations.push_back(0);
+				return delayed.size() - 1;
+			}
 
+			if (instant.size() == used_instant) {
+				instant.push_back();
+			}
+			return used_instant++;
+		}
+
+		/// Allocates the memory for `p_count` new objects at once
+		void reserve(bool is_delayed, const size_t &p_count) {
 			if (is_delayed) {
-				while (objs->size() != (*used)) {
-					if (((*objs)[*used]).is_expired()) {
-						return &(*objs)[(*used)++];
+				if (p_count > delayed_free_slots.size()) {
+					size_t new_size = delayed.size() + p_count - delayed_free_slots.size();
+					delayed.reserve(new_size);
+					delayed_leaves.reserve(new_size);
+					delayed_generations.reserve(new_size);
+				}
+				expiration_heap.reserve(expiration_heap.size() + p_count);
+				return;
+			}
+
+			if (instant.size() < used_instant + p_count) {
+				instant.resize(used_instant + p_count);
+			}
+		}
+
+		/// Sets the absolute expiration time of the new delayed object.
+		void set_delayed_expiration(const size_t &p_idx, const double &p_time) {
+			DelayedRenderer &s = delayed.states[p_idx];
+			s.expiration_time = p_time;
+			s.has_expired = false;
+
+			ExpirationEntry entry = { p_time, (uint32_t)p_idx, delayed_generations[p_idx] };
+			push_expiration_entry(entry);
+
+			if (track_insertion_order) {
+				// Remove the entries of the expired objects if there are too many of them
+				if (insertion_queue.size() > used_delayed * 2 + 64) {
+					insertion_queue.erase(std::remove_if(insertion_queue.begin(), insertion_queue.end(), [this](const ExpirationEntry &e) { return !is_entry_alive(e); }), insertion_queue.end());
+				}
+				insertion_queue.push_back(entry);
+			}
+		}
+
+		_FORCE_INLINE_ void add_payload_bytes(bool is_delayed, const size_t &p_bytes) {
+			(is_delayed ? delayed_payload_bytes : instant_payload_bytes) += p_bytes;
+		}
+
+		/// Estimated memory of the used objects
+		_FORCE_INLINE_ size_t get_used_bytes() const {
+			return (used_instant + used_delayed) * OBJECT_BYTES + instant_payload_bytes + delayed_payload_bytes;
+		}
+
+		/// Returns false if the slot of the entry was reused or already freed
+		_FORCE_INLINE_ bool is_entry_alive(const ExpirationEntry &e) const {
+			if (e.idx >= delayed.size()) {
+				return false;
+			}
+			return !delayed.states[e.idx].has_expired && delayed_generations[e.idx] == e.generation;
+		}
+
+		/// Returns false if the entry is not alive or the expiration time of its object was changed
+		_FORCE_INLINE_ bool is_heap_entry_alive(const ExpirationEntry &e) const {
+			return is_entry_alive(e) && delayed.states[e.idx].expiration_time == e.time;
+		}
+
+		/// Extends the expiration time of the delayed object without changing its insertion order.
+		/// The entry with the old time stays in the heap and is skipped.
+		void extend_delayed_expiration(const size_t &p_idx, const double &p_time) {
+			delayed.states[p_idx].expiration_time = p_time;
+			push_expiration_entry({ p_time, (uint32_t)p_idx, delayed_generations[p_idx] });
+		}
+
+		void push_expiration_entry(const ExpirationEntry &p_entry) {
+			// Remove the entries of the expired, evicted and extended objects if there are too many of them
+			if (expiration_heap.size() > used_delayed * 2 + 64) {
+				expiration_heap.erase(std::remove_if(expiration_heap.begin(), expiration_heap.end(), [this](const ExpirationEntry &e) { return !is_heap_entry_alive(e); }), expiration_heap.end());
+				std::make_heap(expiration_heap.begin(), expiration_heap.end());
+			}
+			expiration_heap.push_back(p_entry);
+			std::push_heap(expiration_heap.begin(), expiration_heap.end());
+		}
+
+		/// Returns true if the same object was added in the current frame.
+		/// `p_is_equal(const TData &)` compares the found object with the new one, so the objects with the same hash are not lost.
+		/// The expiration time of the found delayed object is extended to `p_time`.
+		template <class TEqual>
+		bool find_frame_duplicate(const uint64_t &p_hash, bool is_delayed, const double &p_time, const TEqual &p_is_equal) {
+			auto range = frame_objects.equal_range(p_hash << 1 | (uint64_t)is_delayed);
+			for (auto it = range.first; it != range.second;) {
+				const ExpirationEntry &e = it->second;
+				if (!is_delayed) {
+					if (e.idx < used_instant && p_is_equal(instant.data[e.idx])) {
+						return true;
 					}
-					(*used)++;
+					++it;
+					continue;
 				}
-			} else {
-				if (objs->size() != (*used)) {
-					return &(*objs)[(*used)++];
+
+				// The slot could be evicted and reused
+				if (!is_entry_alive(e)) {
+					it = frame_objects.erase(it);
+					continue;
+				}
+				if (p_is_equal(delayed.data[e.idx])) {
+					if (p_time > delayed.states[e.idx].expiration_time) {
+						extend_delayed_expiration(e.idx, p_time);
+					}
+					return true;
+				}
+				++it;
+			}
+			return false;
+		}
+
+		_FORCE_INLINE_ void add_frame_object(const uint64_t &p_hash, bool is_delayed, const size_t &p_idx, const double &p_time) {
+			frame_objects.insert({ p_hash << 1 | (uint64_t)is_delayed, { p_time, (uint32_t)p_idx, is_delayed ? delayed_generations[p_idx] : 0 } });
+		}
+
+		/// Frees the slot of the delayed object and returns its estimated memory.
+		size_t expire_delayed(const size_t &p_idx) {
+			delayed.states[p_idx].has_expired = true;
+			delayed_generations[p_idx]++;
+			if (p_idx < delayed_leaves.size() && delayed_leaves[p_idx] != -1) {
+				delayed_tree.remove(delayed_leaves[p_idx]);
+				delayed_leaves[p_idx] = -1;
+			}
+			delayed_free_slots.push_back((uint32_t)p_idx);
+			used_delayed--;
+
+			size_t payload = get_payload_bytes(delayed.data[p_idx]);
+			delayed_payload_bytes -= payload;
+			return OBJECT_BYTES + payload;
+		}
+
+		/// Frees one delayed object selected by the policy.
+		/// Returns its estimated memory or 0 if there are no delayed objects.
+		size_t evict_delayed(const EvictionPolicy &p_policy) {
+			ZoneScoped;
+			if (p_policy == EvictionPolicy::OLDEST_FIRST) {
+				while (insertion_queue.size()) {
+					ExpirationEntry e = insertion_queue.front();
+					insertion_queue.pop_front();
+					if (is_entry_alive(e)) {
+						return expire_delayed(e.idx);
+					}
+				}
+			}
+
+			// Also used for the objects that were added before the insertion order was tracked
+			while (expiration_heap.size()) {
+				ExpirationEntry e = expiration_heap.front();
+				std::pop_heap(expiration_heap.begin(), expiration_heap.end());
+				expiration_heap.pop_back();
+				if (is_heap_entry_alive(e)) {
+					return expire_delayed(e.idx);
+				}
+			}
+			return 0;
+		}
+
+		/// Adds the delayed object to the spatial index. Must be called after its bounds are changed.
+		void update_delayed_leaf(const size_t &p_idx) {
+			if (delayed_leaves.size() < delayed.size()) {
+				delayed_leaves.resize(delayed.size(), -1);
+			}
+
+			int32_t &leaf = delayed_leaves[p_idx];
+			if (leaf != -1) {
+				delayed_tree.remove(leaf);
+			}
+			leaf = delayed_tree.insert(delayed.bounds[p_idx], (uint32_t)p_idx);
+		}
+
+		/// Returns true if `update_delayed_expiration` with this time will visit any objects.
+		_FORCE_INLINE_ bool has_expiring_delayed(const double &p_time) const {
+			return expiration_heap.size() && expiration_heap.front().time < p_time;
+		}
+
+		/// Expires the delayed objects whose time is less than `p_time`.
+		/// Only the expired objects are visited, they are removed from the spatial index and their slots are freed.
+		void update_delayed_expiration(const double &p_time) {
+			ZoneScoped;
+			while (expiration_heap.size() && expiration_heap.front().time < p_time) {
+				ExpirationEntry e = expiration_heap.front();
+				std::pop_heap(expiration_heap.begin(), expiration_heap.end());
+				expiration_heap.pop_back();
+
+				if (is_heap_entry_alive(e)) {
+					expire_delayed(e.idx);
+				}
+			}
+		}
+
+		/// Culls the delayed objects by traversing `delayed_tree`.
+		/// Only the objects that are visible now or were visible at the last culling are visited.
+		/// Returns the number of visible objects.
+		/// The slots whose visibility or data have been changed are added to `r_changed_slots`.
+		size_t cull_delayed(const GeometryPoolCullingData *p_culling_data, std::vector<uint32_t> &r_mask_buffer, std::vector<VisibleRange<TData> > &r_visible, std::vector<uint32_t> *r_changed_slots = nullptr, size_t *r_culled_small = nullptr) {
+			ZoneScoped;
+			size_t words = (delayed.size() + 31) / 32;
+			r_mask_buffer.assign(words, 0);
+			delayed_prev_visible.resize(words, 0);
+			if (!words) {
+				return 0;
+			}
+
+			uint32_t *mask = r_mask_buffer.data();
+			size_t visible = delayed_tree.cull(delayed.bounds.data(), p_culling_data->m_frustum_boxes.data(), p_culling_data->m_frustum_boxes.size(), p_culling_data->m_frustums.data(), p_culling_data->m_frustums.size(), mask);
+			bool check_size = r_culled_small && p_culling_data->has_small_objects_culling();
+
+			for (size_t w = 0; w < words; w++) {
+				uint32_t bits = mask[w] | delayed_prev_visible[w];
+				if (!bits) {
+					continue;
+				}
+
+				for (uint32_t b = 0; b < 32; b++) {
+					if (!((bits >> b) & 1)) {
+						continue;
+					}
+
+					size_t i = w * 32 + b;
+					auto &s = delayed.states[i];
+					s.is_visible = (mask[w] >> b) & 1;
+					if (s.is_visible && check_size && p_culling_data->is_too_small(delayed.bounds[i])) {
+						s.is_visible = false;
+						mask[w] &= ~(1u << b);
+						visible--;
+						(*r_culled_small)++;
+					}
+					if (r_changed_slots && (s.is_dirty || s.was_visible != s.is_visible)) {
+						r_changed_slots->push_back((uint32_t)i);
+						s.is_dirty = false;
+					}
+					s.was_visible = s.is_visible;
+
+					if (s.is_visible) {
+						const TData *data = delayed.data.data() + i;
+						if (r_visible.size() && r_visible.back().data + r_visible.back().count == data) {
+							r_visible.back().count++;
+						} else {
+							r_visible.push_back({ data, delayed.bounds.data() + i, 1 });
+						}
+					}
 				}
 			}
 
-			objs->push_back(TInst());
-			return &(*objs)[(*used)++];
+			delayed_prev_visible.assign(mask, mask + words);
+			return visible;
 		}
 
 		void reset_counter(double delta, int custom_type_of_buffer = 0) {
 			ZoneScoped;
+			frame_objects.clear();
+
 			if (instant.size() && used_instant <= (instant.size() * 0.5)) {
 				time_used_less_then_half_of_instant_pool -= delta;
 				if (time_used_less_then_half_of_instant_pool <= 0) {
 					time_used_less_then_half_of_instant_pool = TIME_USED_TO_SHRINK_INSTANT;
 
-					DEV_PRINT_STD("Shrinking instant buffer for %s. From %d, to %d. Buffer type: %d\n", typeid(TInst).name(), instant.size(), used_instant, custom_type_of_buffer);
+					DEV_PRINT_STD("Shrinking instant buffer for %s. From %d, to %d. Buffer type: %d\n", typeid(TData).name(), instant.size(), used_instant, custom_type_of_buffer);
 
 					instant.resize(used_instant);
 				}
@@ -167,17 +667,71 @@ private:
 
 			_prev_used_instant = used_instant;
 			used_instant = 0;
-			_prev_not_expired_delayed = 0;
+			instant_payload_bytes = 0;
 
 			if (delayed.size() && used_delayed <= (delayed.size() * 0.5)) {
 				time_used_less_then_quarter_of_delayed_pool -= delta;
 				if (time_used_less_then_quarter_of_delayed_pool <= 0) {
 					time_used_less_then_quarter_of_delayed_pool = TIME_USED_TO_SHRINK_DELAYED;
 
-					DEV_PRINT_STD("Shrinking _delayed_ buffer for %s. From %d, to %d. Buffer type: %d\n", typeid(TInst).name(), delayed.size(), used_delayed, custom_type_of_buffer);
+					DEV_PRINT_STD("Shrinking _delayed_ buffer for %s. From %d, to %d. Buffer type: %d\n", typeid(TData).name(), delayed.size(), used_delayed, custom_type_of_buffer);
 
-					std::sort(delayed.begin(), delayed.end(), [](const TInst &a, const TInst &b) { return (int)a.is_expired() < (int)b.is_expired(); });
+					// Move the alive objects to the beginning of the arrays
+					delayed_leaves.resize(delayed.size(), -1);
+					std::vector<uint32_t> new_indexes;
+					if (insertion_queue.size()) {
+						new_indexes.assign(delayed.size(), UINT32_MAX);
+					}
+					size_t alive = 0;
+					for (size_t i = 0; i < delayed.size(); i++) {
+						if (!delayed.states[i].is_expired() && alive < used_delayed) {
+							if (new_indexes.size()) {
+								new_indexes[i] = (uint32_t)alive;
+							}
+							if (i != alive) {
+								delayed.move(i, alive);
+								delayed_generations[alive] = delayed_generations[i];
+								delayed_leaves[alive] = delayed_leaves[i];
+								if (delayed_leaves[alive] != -1) {
+									delayed_tree.set_user_index(delayed_leaves[alive], (uint32_t)alive);
+								}
+							}
+							alive++;
+						} else if (delayed_leaves[i] != -1) {
+							delayed_tree.remove(delayed_leaves[i]);
+						}
+						if (i >= alive) {
+							delayed_leaves[i] = -1;
+						}
+					}
 					delayed.resize(used_delayed);
+					delayed_leaves.resize(used_delayed);
+					delayed_generations.resize(used_delayed);
+					delayed_free_slots.clear();
+					delayed_relocations++;
+
+					expiration_heap.clear();
+					for (size_t i = 0; i < used_delayed; i++) {
+						expiration_heap.push_back({ delayed.states[i].expiration_time, (uint32_t)i, delayed_generations[i] });
+					}
+					std::make_heap(expiration_heap.begin(), expiration_heap.end());
+
+					if (new_indexes.size()) {
+						std::deque<ExpirationEntry> queue;
+						for (const auto &e : insertion_queue) {
+							if (e.idx < new_indexes.size() && new_indexes[e.idx] != UINT32_MAX && delayed_generations[new_indexes[e.idx]] == e.generation) {
+								queue.push_back({ e.time, new_indexes[e.idx], e.generation });
+							}
+						}
+						insertion_queue.swap(queue);
+					}
+
+					delayed_prev_visible.assign((used_delayed + 31) / 32, 0);
+					for (size_t i = 0; i < used_delayed; i++) {
+						if (delayed.states[i].was_visible) {
+							delayed_prev_visible[i / 32] |= 1u << (i % 32);
+						}
+					}
 				}
 			} else {
 				time_used_less_then_quarter_of_delayed_pool = TIME_USED_TO_SHRINK_DELAYED;
@@ -187,31 +741,168 @@ private:
 		void clear_pools() {
 			instant.clear();
 			delayed.clear();
+			delayed_tree.clear();
+			delayed_leaves.clear();
+			delayed_prev_visible.clear();
+			delayed_generations.clear();
+			expiration_heap.clear();
+			insertion_queue.clear();
+			frame_objects.clear();
+			delayed_free_slots.clear();
+			delayed_relocations++;
 			used_instant = 0;
 			used_delayed = 0;
+			instant_payload_bytes = 0;
+			delayed_payload_bytes = 0;
 			_prev_used_instant = 0;
-			_prev_not_expired_delayed = 0;
 			time_used_less_then_half_of_instant_pool = 0;
 		}
 	};
 
 	struct processTypePools {
-		ObjectsPool<DelayedRendererInstance> instances[(int)InstanceType::MAX];
-		ObjectsPool<DelayedRendererLine> lines;
+		ObjectsPool<GeometryPoolData3DInstance> instances[(int)InstanceType::MAX];
+		ObjectsPool<GeometryPoolDataLines> lines;
+		LinesArena lines_arena;
+	};
+
+	enum : int {
+		// Pools of each depth test mode and process type in each viewport. See `_get_pools_index`.
+		POOLS_PER_VIEWPORT = (int)DepthTestMode::MAX * (int)ProcessType::MAX,
+		// Buffers of each instance type for each depth test mode. See `_get_buffer_index`.
+		INSTANCE_BUFFERS_COUNT = (int)DepthTestMode::MAX * (int)InstanceType::MAX,
+	};
+
+	// Objects in a single task of culling and filling the instance buffers
+	enum : size_t {
+		INSTANCES_TASK_MAX_OBJECTS = 8192,
+		INSTANCES_MIN_OBJECTS_FOR_THREADS = 4096,
+		// The changed instances are uploaded by the MultiMesh setters if they are less than this part of the buffer.
+		// Otherwise the whole buffer is uploaded once.
+		INSTANCES_PARTIAL_UPLOAD_MAX_PART = 16,
+	};
+
+	struct InstancesRange {
+		size_t start;
+		size_t count;
+	};
+
+	// Visible objects of a task that are written to the buffer with the index `type`
+	struct InstancesFillOutput {
+		int type;
+		size_t visible;
+		size_t buffer_offset;
+		float *buffer_write;
+		// Union of the bounds of the visible objects
+		AABBMinMax bounds;
+		std::vector<VisibleRange<GeometryPoolData3DInstance> > visible_ranges;
+		// Instances of the buffer that differ from the uploaded ones
+		std::vector<InstancesRange> changed_ranges;
+		size_t changed_count;
+		// Offset of the previous frame to detect the moved slots of the delayed objects
+		int prev_type;
+		size_t prev_buffer_offset;
 	};
 
-	std::unordered_map<Viewport *, processTypePools[(int)ProcessType::MAX]> pools;
+	struct InstancesFillTask {
+		// Index of the buffer of the pool
+		int type;
+		ObjectsPool<GeometryPoolData3DInstance> *pool;
+		ObjectsArrays<GeometryPoolData3DInstance> *arr;
+		const GeometryPoolCullingData *culling_data;
+		size_t start;
+		size_t count;
+		bool is_delayed;
+		bool is_physics;
+
+		size_t visible;
+		size_t culled_small;
+		std::vector<uint32_t> visibility_mask;
+		std::vector<VisibleRange<GeometryPoolData3DInstance> > visible_ranges;
+		// Visible objects split by LOD. The types without LOD use only `InstanceLOD::NORMAL`.
+		InstancesFillOutput outputs[(int)InstanceLOD::MAX];
+
+		// Each delayed object has a stable slot in the buffer of each output: `buffer_offset` + its index.
+		// The slots of the expired and hidden objects contain the zero transform, so adding or removing an object changes only its slot.
+		size_t delayed_slots;
+		// Delayed objects whose visibility, LOD or data have been changed
+		std::vector<uint32_t> changed_slots;
+		bool is_lod_split;
+		// All slots are written if they have been moved since the previous frame
+		bool is_refill;
+		// State of the previous frame. Tasks of the delayed objects are created first, so they keep their indexes.
+		const ObjectsArrays<GeometryPoolData3DInstance> *prev_arr;
+		size_t prev_delayed_slots;
+		uint32_t prev_relocations;
+		bool prev_is_lod_split;
+	};
+
+	std::unordered_map<Viewport *, processTypePools[POOLS_PER_VIEWPORT]> pools;
 	std::unordered_map<Viewport *, uint64_t> viewport_ids;
 
 	double process_delta_sum = 0;
 	double physics_delta_sum = 0;
+	// Clocks of the expiration of the delayed objects. They are advanced after the objects are rendered.
+	double process_time = 0;
+	double physics_time = 0;
+
+	std::vector<InstancesFillTask> instances_fill_tasks;
+	_DD3D_GroupTask *group_task = nullptr;
+
+	// Copies of the uploaded buffers. The new data is compared with them to find the changed instances.
+	PackedFloat32Array temp_instances_buffers[INSTANCE_BUFFERS_COUNT];
+	size_t prev_buffer_visible_instance_count[INSTANCE_BUFFERS_COUNT] = {};
+	RID uploaded_meshes[INSTANCE_BUFFERS_COUNT];
+	uint64_t pools_layout_version = 0;
+	uint64_t uploaded_pools_layout_version = 0;
+
+	enum : size_t {
+		// Must be even to not split the lines
+		LINES_CHUNK_MAX_VERTEXES = 512,
+	};
 
-	PackedFloat32Array temp_instances_buffers[(int)InstanceType::MAX];
-	size_t prev_buffer_visible_instance_count[(int)InstanceType::MAX] = {};
-	size_t prev_buffer_visible_lines_count = 0;
+	// Persistent surface of lines of each depth test mode.
+	// The surface is recreated only when the capacity changes, otherwise the vertices are updated in place.
+	enum : int64_t {
+		LINES_SURFACE_MIN_CAPACITY = 1024,
+	};
+	struct LinesSurface {
+		int64_t capacity = 0;
+		int64_t written = 0;
+		double time_used_less_then_quarter = 0;
+		uint32_t vertex_stride = 0;
+		uint32_t attribute_stride = 0;
+		uint32_t color_offset = 0;
+		size_t prev_visible_count = 0;
+		PackedByteArray temp_vertex_buffer;
+		PackedByteArray temp_attribute_buffer;
+	};
+	LinesSurface lines_surfaces[(int)DepthTestMode::MAX];
 
 	uint64_t stat_visible_instances = 0;
 	uint64_t stat_visible_lines = 0;
+	uint64_t stat_culled_small_instances = 0;
+	uint64_t stat_culled_small_lines = 0;
+
+	GeometryPoolLimits limits;
+	// Estimated memory of all objects. It is recalculated every frame and updated when objects are added.
+	size_t used_bytes = 0;
+	uint64_t frame_evicted_objects = 0;
+	uint64_t frame_rejected_objects = 0;
+	uint64_t stat_evicted_objects = 0;
+	uint64_t stat_rejected_objects = 0;
+
+	bool use_deduplication = false;
+	uint64_t frame_deduplicated_objects = 0;
+	uint64_t stat_deduplicated_objects = 0;
+
+	// Signature of the last filled frame. The next frame is not filled if it is the same.
+	// Incremented when objects are added or removed
+	uint64_t objects_generation = 0;
+	uint64_t filled_objects_generation = UINT64_MAX;
+	uint64_t filled_pools_layout_version = 0;
+	std::vector<RID> filled_meshes;
+	std::unordered_map<Viewport *, std::shared_ptr<GeometryPoolCullingData> > filled_culling_data;
+	uint64_t stat_skipped_frames = 0;
 	int64_t time_spent_to_fill_buffers_of_instances = 0;
 	int64_t time_spent_to_fill_buffers_of_lines = 0;
 	int64_t time_spent_to_cull_instances = 0;
@@ -222,32 +913,84 @@ private:
 	InstanceType _scoped_config_type_convert(ConvertableInstanceType p_type, const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg);
 	GeometryType _scoped_config_get_geometry_type(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg);
 
-	bool _is_viewport_empty(Viewport *vp);
+	static InstanceType _get_lod_type(const InstanceType &p_type, const InstanceLOD &p_lod);
+	static _FORCE_INLINE_ int _get_pools_index(const DepthTestMode &p_depth, const ProcessType &p_proc) {
+		return (int)p_depth * (int)ProcessType::MAX + (int)p_proc;
+	}
+	static _FORCE_INLINE_ int _get_buffer_index(const DepthTestMode &p_depth, const int &p_type) {
+		return (int)p_depth * (int)InstanceType::MAX + p_type;
+	}
+	/// Returns the first LOD of the task that is written to the same buffer. The delayed slots are reserved only by it.
+	static _FORCE_INLINE_ int _get_slots_owner_lod(const InstancesFillTask &p_task, const int &p_lod) {
+		for (int lod = 0; lod < p_lod; lod++) {
+			if (p_task.outputs[lod].type == p_task.outputs[p_lod].type) {
+				return lod;
+			}
+		}
+		return p_lod;
+	}
+	static uint64_t _get_instance_hash(const GeometryPoolData3DInstance &p_data);
+	static uint64_t _get_lines_hash(const Vector3 *p_lines, const size_t &p_line_count, const Color &p_col);
 
-	void fill_instance_data(const std::vector<Ref<MultiMesh> *> &p_meshes, std::unordered_map<Viewport *, std::shared_ptr<GeometryPoolCullingData> > &p_culling_data);
-	void fill_lines_data(Ref<ArrayMesh> p_ig, std::unordered_map<Viewport *, std::shared_ptr<GeometryPoolCullingData> > &p_culling_data);
+	bool _is_viewport_empty(Viewport *vp);
+	void _check_instant_objects_removal(const processTypePools &p_proc);
+	void _update_used_bytes();
+	/// Evicts the delayed objects of the pool until a new object fits into the limits.
+	/// The memory limit is shared by all pools, so if this pool has nothing to evict, the objects of other pools are evicted.
+	/// Returns false if the new object must be rejected.
+	template <class TData>
+	bool _make_room(ObjectsPool<TData> &p_pool, const size_t &p_max_objects, const size_t &p_new_bytes);
+	/// Evicts one delayed object from the first pool that has them. Returns its estimated memory or 0.
+	size_t _evict_from_any_pool();
+	double _get_expiration_time(const ProcessType &p_proc, const real_t &p_exp_time);
+	void _add_lines_chunk(processTypePools &p_proc, const double &p_exp_time, const Vector3 *p_lines, const size_t p_line_count, const Color &p_col, const std::shared_ptr<const std::vector<Vector3> > &p_owner);
+
+	void _cull_instances_task(InstancesFillTask &p_task);
+	void _split_instances_by_lod(InstancesFillTask &p_task);
+	void _fill_instances_task(InstancesFillTask &p_task);
+	/// Copies the instance to the buffer of the output if it differs and adds it to the changed instances
+	static void _write_instance(InstancesFillOutput &o, const size_t &p_idx, const float *p_data);
+	/// Returns true if the buffers filled in the last frame are still valid.
+	bool _is_frame_unchanged(const std::vector<MultiMeshBuffer *> &p_meshes, std::unordered_map<Viewport *, std::shared_ptr<GeometryPoolCullingData> > &p_culling_data);
+	void fill_instance_data(const std::vector<MultiMeshBuffer *> &p_meshes, std::unordered_map<Viewport *, std::shared_ptr<GeometryPoolCullingData> > &p_culling_data);
+	void _update_lines_surface_capacity(const DepthTestMode &p_depth, Ref<ArrayMesh> &p_ig, const int64_t &p_used_vertexes);
+	void _fill_lines_surface(const DepthTestMode &p_depth, Ref<ArrayMesh> &p_ig, std::unordered_map<Viewport *, std::shared_ptr<GeometryPoolCullingData> > &p_culling_data);
+	void fill_lines_data(const std::vector<Ref<ArrayMesh> *> &p_lines_meshes, std::unordered_map<Viewport *, std::shared_ptr<GeometryPoolCullingData> > &p_culling_data);
 
 public:
 	GeometryPool() {}
+	~GeometryPool();
 
-	~GeometryPool() {
-	}
-
-	void set_no_depth_test_info(bool p_no_depth_test);
+	void set_limits(const GeometryPoolLimits &p_limits);
+	void set_deduplication(bool p_enabled);
 
 	std::vector<Viewport *> get_and_validate_viewports();
 
-	void fill_mesh_data(const std::vector<Ref<MultiMesh> *> &p_meshes, Ref<ArrayMesh> p_ig, std::unordered_map<Viewport *, std::shared_ptr<GeometryPoolCullingData> > &p_culling_data);
+	/// Returns true if there are objects of this depth test mode
+	bool has_objects(const DepthTestMode &p_depth);
+	/// Marks in `p_used` (InstanceType::MAX elements) the types of this depth test mode whose MultiMeshes can receive objects.
+	/// The types with LOD also mark the types of their LOD meshes.
+	void get_used_types(const DepthTestMode &p_depth, bool *p_used);
+	/// `p_meshes` contains the MultiMeshes of each instance type for each depth test mode and `p_lines_meshes` the meshes of lines for each mode.
+	/// The meshes of the unused modes and types can be nullptr.
+	void fill_mesh_data(const std::vector<MultiMeshBuffer *> &p_meshes, const std::vector<Ref<ArrayMesh> *> &p_lines_meshes, std::unordered_map<Viewport *, std::shared_ptr<GeometryPoolCullingData> > &p_culling_data);
 	void reset_counter(const double &p_delta, const ProcessType &p_proc = ProcessType::MAX);
 	void reset_visible_objects();
+	/// The next frame will be filled even if nothing has been changed.
+	void force_next_fill();
+	/// Must be called after the surfaces of the lines meshes have been removed.
+	void reset_lines_surfaces();
 	void set_stats(Ref<DebugDraw3DStats> &p_stats) const;
 	void clear_pool();
-	void for_each_instance(const std::function<void(DelayedRendererInstance *)> &p_func);
-	void for_each_line(const std::function<void(DelayedRendererLine *)> &p_func);
+	void for_each_instance(const std::function<void(const DelayedRenderer &, const AABBMinMax &)> &p_func);
+	void for_each_line(const std::function<void(const DelayedRenderer &, const AABBMinMax &)> &p_func);
 	void update_expiration_delta(const double &p_delta, const ProcessType &p_proc);
 	void add_or_update_instance(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg, ConvertableInstanceType p_type, const real_t &p_exp_time, const ProcessType &p_proc, const Transform3D &p_transform, const Color &p_col, const SphereBounds &p_bounds, const Color *p_custom_col = nullptr);
 	void add_or_update_instance(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg, InstanceType p_type, const real_t &p_exp_time, const ProcessType &p_proc, const Transform3D &p_transform, const Color &p_col, const SphereBounds &p_bounds, const Color *p_custom_col = nullptr);
-	void add_or_update_line(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg, const real_t &p_exp_time, const ProcessType &p_proc, std::unique_ptr<Vector3[]> p_lines, const size_t p_line_count, const Color &p_col);
+	void add_or_update_instances(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg, ConvertableInstanceType p_type, const real_t &p_exp_time, const ProcessType &p_proc, const Transform3D *p_transforms, const Color *p_colors, const SphereBounds *p_bounds, const size_t &p_count, const Color *p_custom_col = nullptr);
+	void add_or_update_instances(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg, InstanceType p_type, const real_t &p_exp_time, const ProcessType &p_proc, const Transform3D *p_transforms, const Color *p_colors, const SphereBounds *p_bounds, const size_t &p_count, const Color *p_custom_col = nullptr);
+	/// If `p_owner` is specified, `p_lines` must point to its data. The instant lines will use it without copying.
+	void add_or_update_line(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg, const real_t &p_exp_time, const ProcessType &p_proc, const Vector3 *p_lines, const size_t p_line_count, const Color &p_col, const std::shared_ptr<const std::vector<Vector3> > &p_owner = nullptr);
 };
 
 #endif
\ No newline at end of file
@@ -18,13 +18,17 @@ enum class ConvertableInstanceType : char {
 
 enum class InstanceType : char {
 	// Basic wireframe
+	LINE,
 	CUBE,
 	CUBE_CENTERED,
 	ARROWHEAD,
 	POSITION,
+	SPHERE_LD,
 	SPHERE,
 	SPHERE_HD,
+	CYLINDER_LD,
 	CYLINDER,
+	CYLINDER_AB_LD,
 	CYLINDER_AB,
 
 	// Volumetric from wireframes
@@ -33,9 +37,12 @@ enum class InstanceType : char {
 	CUBE_CENTERED_VOLUMETRIC,
 	ARROWHEAD_VOLUMETRIC,
 	POSITION_VOLUMETRIC,
+	SPHERE_LD_VOLUMETRIC,
 	SPHERE_VOLUMETRIC,
 	SPHERE_HD_VOLUMETRIC,
+	CYLINDER_LD_VOLUMETRIC,
 	CYLINDER_VOLUMETRIC,
+	CYLINDER_AB_LD_VOLUMETRIC,
 	CYLINDER_AB_VOLUMETRIC,
 
 	// Solid geometry
@@ -45,6 +52,28 @@ enum class InstanceType : char {
 	MAX,
 };
 
+// Level of detail selected by the size of an instance on the screen
+enum class InstanceLOD : char {
+	LOW,
+	NORMAL,
+	HIGH,
+	MAX,
+};
+
+// What to do when a limit of a GeometryPool is reached
+enum class EvictionPolicy : char {
+	OLDEST_FIRST,
+	NEAREST_TO_EXPIRY,
+	REJECT_NEW,
+};
+
+// Objects with and without the depth test are drawn by separate MultiMeshes and surfaces of lines
+enum class DepthTestMode : char {
+	NORMAL,
+	NO_DEPTH,
+	MAX,
+};
+
 enum class ProcessType : char {
 	PROCESS,
 	PHYSICS_PROCESS,
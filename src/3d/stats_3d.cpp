@@ -16,6 +16,12 @@ void DebugDraw3DStats::_bind_methods() {
 	REG_PROPERTY_NO_SET(visible_instances, Variant::INT);
 	REG_PROPERTY_NO_SET(visible_lines, Variant::INT);
 	REG_PROPERTY_NO_SET(total_visible, Variant::INT);
+	REG_PROPERTY_NO_SET(culled_small_instances, Variant::INT);
+	REG_PROPERTY_NO_SET(culled_small_lines, Variant::INT);
+	REG_PROPERTY_NO_SET(evicted_objects, Variant::INT);
+	REG_PROPERTY_NO_SET(rejected_objects, Variant::INT);
+	REG_PROPERTY_NO_SET(deduplicated_objects, Variant::INT);
+	REG_PROPERTY_NO_SET(skipped_frames, Variant::INT);
 
 	REG_PROPERTY_NO_SET(time_filling_buffers_instances_usec, Variant::INT);
 	REG_PROPERTY_NO_SET(time_filling_buffers_lines_usec, Variant::INT);
@@ -53,7 +59,17 @@ void DebugDraw3DStats::set_render_stats(
 		const int64_t &p_time_filling_buffers_instances_usec,
 		const int64_t &p_time_filling_buffers_lines_usec,
 		const int64_t &p_time_culling_instances_usec,
-		const int64_t &p_time_culling_lines_usec) {
+		const int64_t &p_time_culling_lines_usec,
+
+		const int64_t &p_culled_small_instances,
+		const int64_t &p_culled_small_lines,
+
+		const int64_t &p_evicted_objects,
+		const int64_t &p_rejected_objects,
+
+		const int64_t &p_deduplicated_objects,
+
+		const int64_t &p_skipped_frames) {
 
 	instances = p_instances;
 	lines = p_lines;
@@ -68,6 +84,12 @@ void DebugDraw3DStats::set_render_stats(
 	visible_lines = p_visible_lines;
 	total_visible = visible_instances +
 					visible_lines;
+	culled_small_instances = p_culled_small_instances;
+	culled_small_lines = p_culled_small_lines;
+	evicted_objects = p_evicted_objects;
+	rejected_objects = p_rejected_objects;
+	deduplicated_objects = p_deduplicated_objects;
+	skipped_frames = p_skipped_frames;
 
 	time_filling_buffers_instances_usec = p_time_filling_buffers_instances_usec;
 	time_filling_buffers_lines_usec = p_time_filling_buffers_lines_usec;
@@ -92,6 +114,12 @@ void DebugDraw3DStats::combine_with(const Ref<DebugDraw3DStats> p_other) {
 	visible_instances += p_other->visible_instances;
 	visible_lines += p_other->visible_lines;
 	total_visible += p_other->total_visible;
+	culled_small_instances += p_other->culled_small_instances;
+	culled_small_lines += p_other->culled_small_lines;
+	evicted_objects += p_other->evicted_objects;
+	rejected_objects += p_other->rejected_objects;
+	deduplicated_objects += p_other->deduplicated_objects;
+	skipped_frames += p_other->skipped_frames;
 
 	time_filling_buffers_instances_usec += p_other->time_filling_buffers_instances_usec;
 	time_filling_buffers_lines_usec += p_other->time_filling_buffers_lines_usec;
@@ -19,6 +19,18 @@ using namespace godot;
  *
  * `instances_physics` reports how many instances were created inside `_physics_process`.
  *
+ * `evicted_objects` and `rejected_objects` report how many objects were removed or not added in the last frame
+ * because of the limits in DebugDraw3DConfig.
+ *
+ * `deduplicated_objects` reports how many repeated objects were skipped in the last frame
+ * if DebugDraw3DConfig.set_use_deduplication is enabled.
+ *
+ * `skipped_frames` reports in how many frames since the start the culling and the update of the buffers were skipped,
+ * because neither the geometry nor the cameras have been changed.
+ *
+ * `culled_small_instances` and `culled_small_lines` report how many instances and chunks of lines were hidden
+ * because they are smaller than DebugDraw3DConfig.set_culling_min_pixel_radius.
+ *
  * `total_time_spent_usec` reports the time in microseconds spent to process everything and display the geometry on the screen.
  */
 class DebugDraw3DStats : public RefCounted {
@@ -45,6 +57,12 @@ public:                                      \
 	DEFINE_DEFAULT_PROP(visible_instances, int64_t, 0);
 	DEFINE_DEFAULT_PROP(visible_lines, int64_t, 0);
 	DEFINE_DEFAULT_PROP(total_visible, int64_t, 0);
+	DEFINE_DEFAULT_PROP(culled_small_instances, int64_t, 0);
+	DEFINE_DEFAULT_PROP(culled_small_lines, int64_t, 0);
+	DEFINE_DEFAULT_PROP(evicted_objects, int64_t, 0);
+	DEFINE_DEFAULT_PROP(rejected_objects, int64_t, 0);
+	DEFINE_DEFAULT_PROP(deduplicated_objects, int64_t, 0);
+	DEFINE_DEFAULT_PROP(skipped_frames, int64_t, 0);
 
 	DEFINE_DEFAULT_PROP(time_filling_buffers_instances_usec, int64_t, 0);
 	DEFINE_DEFAULT_PROP(time_filling_buffers_lines_usec, int64_t, 0);
@@ -83,7 +101,13 @@ public:                                      \
 			const int64_t &p_time_filling_buffers_instances_usec,
 			const int64_t &p_time_filling_buffers_lines_usec,
 			const int64_t &p_time_culling_instances_usec,
-			const int64_t &p_time_culling_lines_usec);
+			const int64_t &p_time_culling_lines_usec,
+			const int64_t &p_culled_small_instances,
+			const int64_t &p_culled_small_lines,
+			const int64_t &p_evicted_objects,
+			const int64_t &p_rejected_objects,
+			const int64_t &p_deduplicated_objects,
+			const int64_t &p_skipped_frames);
 
 	///  @private
 	void combine_with(const Ref<DebugDraw3DStats> p_other);
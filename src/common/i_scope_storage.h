@@ -18,7 +18,8 @@ private:
 	virtual void _unregister_scoped_config(uint64_t thread_id, uint64_t guard_id) = 0;
 	virtual void _clear_scoped_configs() = 0;
 
-	virtual const std::shared_ptr<TCfgStorageData> scoped_config_for_current_thread() = 0;
+	// Returns a borrowed pointer that is valid until the end of the current scope
+	virtual TCfgStorageData *scoped_config_for_current_thread() = 0;
 #endif
 
 public:
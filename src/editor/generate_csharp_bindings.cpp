@@ -101,17 +101,21 @@ void GenerateCSharpBindingsPlugin::generate() {
 			"DebugDraw3DStats",
 			"DebugDraw3DConfig",
 			"DebugDraw3DScopeConfig",
+			"DebugDraw3DBatchScope",
 			"DebugDrawManager"));
 
 	avoid_caching_for_classes = TypedArray<StringName>(Array::make(
-			"DebugDraw3DScopeConfig"));
+			"DebugDraw3DScopeConfig",
+			"DebugDraw3DBatchScope"));
 
 	additional_statics_for_classes = extend_class_strings{
-		{ "DebugDraw3DScopeConfig", { "private static readonly StringName ___manual_unregister = \"_manual_unregister\";" } }
+		{ "DebugDraw3DScopeConfig", { "private static readonly StringName ___manual_unregister = \"_manual_unregister\";" } },
+		{ "DebugDraw3DBatchScope", { "private static readonly StringName ___manual_end = \"_manual_end\";" } }
 	};
 
 	override_disposable_for_classes = extend_class_strings{
-		{ "DebugDraw3DScopeConfig", { "Instance?.Call(___manual_unregister);" } }
+		{ "DebugDraw3DScopeConfig", { "Instance?.Call(___manual_unregister);" } },
+		{ "DebugDraw3DBatchScope", { "Instance?.Call(___manual_end);" } }
 	};
 
 	singletons = Engine::get_singleton()->get_singleton_list();
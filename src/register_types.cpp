@@ -4,9 +4,11 @@
 #include "2d/debug_draw_2d.h"
 #include "2d/graphs.h"
 #include "2d/stats_2d.h"
+#include "3d/batch_scope_3d.h"
 #include "3d/config_3d.h"
 #include "3d/config_scope_3d.h"
 #include "3d/debug_draw_3d.h"
+#include "3d/render_instances.h"
 #include "3d/stats_3d.h"
 #include "debug_draw_manager.h"
 #include "utils/utils.h"
@@ -44,6 +46,7 @@ void initialize_debug_draw_3d_module(ModuleInitializationLevel p_level) {
 		// TODO register as unexposed
 		ClassDB::register_class<_DD3D_PhysicsWatcher>();
 		ClassDB::register_class<_DD3D_WorldWatcher>();
+		ClassDB::register_class<_DD3D_GroupTask>();
 #endif
 
 		ClassDB::register_class<DebugDraw2D>();
@@ -56,6 +59,7 @@ void initialize_debug_draw_3d_module(ModuleInitializationLevel p_level) {
 		ClassDB::register_class<DebugDraw3DStats>();
 		ClassDB::register_class<DebugDraw3DConfig>();
 		ClassDB::register_class<DebugDraw3DScopeConfig>();
+		ClassDB::register_class<DebugDraw3DBatchScope>();
 
 		ClassDB::register_class<DebugDrawManager>();
 
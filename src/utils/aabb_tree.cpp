@@ -0,0 +1,376 @@
+#include "aabb_tree.h"
+
+#include "profiler.h"
+
+#include <algorithm>
+
+static _FORCE_INLINE_ real_t get_area(const Vector3 &p_min, const Vector3 &p_max) {
+	Vector3 d = p_max - p_min;
+	return 2 * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+int32_t AABBTree::alloc_node() {
+	if (free_list == NULL_NODE) {
+		nodes.emplace_back();
+		return (int32_t)nodes.size() - 1;
+	}
+
+	int32_t id = free_list;
+	free_list = nodes[id].parent_or_next;
+	nodes[id] = Node();
+	return id;
+}
+
+void AABBTree::free_node(int32_t p_node) {
+	Node &n = nodes[p_node];
+	n.parent_or_next = free_list;
+	n.height = -1;
+	free_list = p_node;
+}
+
+void AABBTree::refit(int32_t p_node) {
+	Node &n = nodes[p_node];
+	const Node &c1 = nodes[n.child1];
+	const Node &c2 = nodes[n.child2];
+	n.min = c1.min.min(c2.min);
+	n.max = c1.max.max(c2.max);
+	n.height = 1 + std::max(c1.height, c2.height);
+}
+
+void AABBTree::insert_leaf(int32_t p_leaf) {
+	if (root == NULL_NODE) {
+		root = p_leaf;
+		nodes[root].parent_or_next = NULL_NODE;
+		return;
+	}
+
+	// Find the best sibling using the surface area heuristic
+	const Vector3 leaf_min = nodes[p_leaf].min;
+	const Vector3 leaf_max = nodes[p_leaf].max;
+	int32_t index = root;
+	while (!nodes[index].is_leaf()) {
+		const Node &n = nodes[index];
+
+		real_t area = get_area(n.min, n.max);
+		real_t combined_area = get_area(n.min.min(leaf_min), n.max.max(leaf_max));
+
+		// Cost of creating a new parent for this node and the new leaf
+		real_t cost = 2 * combined_area;
+		// Minimum cost of pushing the leaf further down the tree
+		real_t inheritance_cost = 2 * (combined_area - area);
+
+		auto child_cost = [&](int32_t p_child) {
+			const Node &c = nodes[p_child];
+			real_t new_area = get_area(c.min.min(leaf_min), c.max.max(leaf_max));
+			return c.is_leaf() ? new_area + inheritance_cost : (new_area - get_area(c.min, c.max)) + inheritance_cost;
+		};
+
+		real_t cost1 = child_cost(n.child1);
+		real_t cost2 = child_cost(n.child2);
+
+		if (cost < cost1 && cost < cost2) {
+			break;
+		}
+
+		index = cost1 < cost2 ? n.child1 : n.child2;
+	}
+
+	int32_t sibling = index;
+	int32_t old_parent = nodes[sibling].parent_or_next;
+	int32_t new_parent = alloc_node();
+	{
+		Node &np = nodes[new_parent];
+		np.parent_or_next = old_parent;
+		np.min = leaf_min.min(nodes[sibling].min);
+		np.max = leaf_max.max(nodes[sibling].max);
+		np.height = nodes[sibling].height + 1;
+		np.child1 = sibling;
+		np.child2 = p_leaf;
+	}
+
+	if (old_parent != NULL_NODE) {
+		Node &op = nodes[old_parent];
+		if (op.child1 == sibling) {
+			op.child1 = new_parent;
+		} else {
+			op.child2 = new_parent;
+		}
+	} else {
+		root = new_parent;
+	}
+	nodes[sibling].parent_or_next = new_parent;
+	nodes[p_leaf].parent_or_next = new_parent;
+
+	// Walk back up the tree fixing heights and bounds
+	index = nodes[p_leaf].parent_or_next;
+	while (index != NULL_NODE) {
+		index = balance(index);
+		refit(index);
+		index = nodes[index].parent_or_next;
+	}
+}
+
+void AABBTree::remove_leaf(int32_t p_leaf) {
+	if (p_leaf == root) {
+		root = NULL_NODE;
+		return;
+	}
+
+	int32_t parent = nodes[p_leaf].parent_or_next;
+	int32_t grand_parent = nodes[parent].parent_or_next;
+	int32_t sibling = nodes[parent].child1 == p_leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+	if (grand_parent != NULL_NODE) {
+		Node &gp = nodes[grand_parent];
+		if (gp.child1 == parent) {
+			gp.child1 = sibling;
+		} else {
+			gp.child2 = sibling;
+		}
+		nodes[sibling].parent_or_next = grand_parent;
+		free_node(parent);
+
+		int32_t index = grand_parent;
+		while (index != NULL_NODE) {
+			index = balance(index);
+			refit(index);
+			index = nodes[index].parent_or_next;
+		}
+	} else {
+		root = sibling;
+		nodes[sibling].parent_or_next = NULL_NODE;
+		free_node(parent);
+	}
+}
+
+int32_t AABBTree::balance(int32_t p_node) {
+	const int32_t ia = p_node;
+	Node &a = nodes[ia];
+	if (a.is_leaf() || a.height < 2) {
+		return ia;
+	}
+
+	const int32_t ib = a.child1;
+	const int32_t ic = a.child2;
+	Node &b = nodes[ib];
+	Node &c = nodes[ic];
+
+	auto replace_in_parent = [this](const int32_t &p_parent, const int32_t &p_old, const int32_t &p_new) {
+		if (p_parent != NULL_NODE) {
+			Node &p = nodes[p_parent];
+			if (p.child1 == p_old) {
+				p.child1 = p_new;
+			} else {
+				p.child2 = p_new;
+			}
+		} else {
+			root = p_new;
+		}
+	};
+
+	int32_t balance_value = c.height - b.height;
+
+	// Rotate C up
+	if (balance_value > 1) {
+		const int32_t i_f = c.child1;
+		const int32_t i_g = c.child2;
+		Node &f = nodes[i_f];
+		Node &g = nodes[i_g];
+
+		c.child1 = ia;
+		c.parent_or_next = a.parent_or_next;
+		a.parent_or_next = ic;
+		replace_in_parent(c.parent_or_next, ia, ic);
+
+		if (f.height > g.height) {
+			c.child2 = i_f;
+			a.child2 = i_g;
+			g.parent_or_next = ia;
+			a.min = b.min.min(g.min);
+			a.max = b.max.max(g.max);
+			c.min = a.min.min(f.min);
+			c.max = a.max.max(f.max);
+			a.height = 1 + std::max(b.height, g.height);
+			c.height = 1 + std::max(a.height, f.height);
+		} else {
+			c.child2 = i_g;
+			a.child2 = i_f;
+			f.parent_or_next = ia;
+			a.min = b.min.min(f.min);
+			a.max = b.max.max(f.max);
+			c.min = a.min.min(g.min);
+			c.max = a.max.max(g.max);
+			a.height = 1 + std::max(b.height, f.height);
+			c.height = 1 + std::max(a.height, g.height);
+		}
+		return ic;
+	}
+
+	// Rotate B up
+	if (balance_value < -1) {
+		const int32_t i_d = b.child1;
+		const int32_t i_e = b.child2;
+		Node &d = nodes[i_d];
+		Node &e = nodes[i_e];
+
+		b.child1 = ia;
+		b.parent_or_next = a.parent_or_next;
+		a.parent_or_next = ib;
+		replace_in_parent(b.parent_or_next, ia, ib);
+
+		if (d.height > e.height) {
+			b.child2 = i_d;
+			a.child1 = i_e;
+			e.parent_or_next = ia;
+			a.min = c.min.min(e.min);
+			a.max = c.max.max(e.max);
+			b.min = a.min.min(d.min);
+			b.max = a.max.max(d.max);
+			a.height = 1 + std::max(c.height, e.height);
+			b.height = 1 + std::max(a.height, d.height);
+		} else {
+			b.child2 = i_e;
+			a.child1 = i_d;
+			d.parent_or_next = ia;
+			a.min = c.min.min(d.min);
+			a.max = c.max.max(d.max);
+			b.min = a.min.min(e.min);
+			b.max = a.max.max(e.max);
+			a.height = 1 + std::max(c.height, d.height);
+			b.height = 1 + std::max(a.height, e.height);
+		}
+		return ib;
+	}
+
+	return ia;
+}
+
+int32_t AABBTree::insert(const AABBMinMax &p_bounds, const uint32_t &p_user_index) {
+	ZoneScoped;
+	int32_t leaf = alloc_node();
+	Node &n = nodes[leaf];
+	// The sphere can be larger than the box, so both are included to get the correct frustum test
+	Vector3 r = Vector3(p_bounds.radius, p_bounds.radius, p_bounds.radius);
+	n.min = p_bounds.min.min(p_bounds.center - r);
+	n.max = p_bounds.max.max(p_bounds.center + r);
+	n.height = 0;
+	n.user_index = p_user_index;
+
+	insert_leaf(leaf);
+	leaves_count++;
+	return leaf;
+}
+
+void AABBTree::remove(const int32_t &p_leaf) {
+	ZoneScoped;
+	remove_leaf(p_leaf);
+	free_node(p_leaf);
+	leaves_count--;
+}
+
+void AABBTree::set_user_index(const int32_t &p_leaf, const uint32_t &p_user_index) {
+	nodes[p_leaf].user_index = p_user_index;
+}
+
+void AABBTree::clear() {
+	nodes.clear();
+	root = NULL_NODE;
+	free_list = NULL_NODE;
+	leaves_count = 0;
+}
+
+void AABBTree::add_subtree_to_mask(int32_t p_node, uint32_t *r_mask, size_t &r_count) {
+	const Node &n = nodes[p_node];
+	if (n.is_leaf()) {
+		r_mask[n.user_index / 32] |= 1u << (n.user_index % 32);
+		r_count++;
+		return;
+	}
+	add_subtree_to_mask(n.child1, r_mask, r_count);
+	add_subtree_to_mask(n.child2, r_mask, r_count);
+}
+
+size_t AABBTree::cull(const AABBMinMax *p_bounds, const AABBMinMax *p_boxes, const size_t &p_boxes_count, const std::array<Plane, 6> *p_frustums, const size_t &p_frustums_count, uint32_t *r_mask) {
+	ZoneScoped;
+	size_t count = 0;
+	if (root == NULL_NODE) {
+		return count;
+	}
+
+	stack.clear();
+	stack.push_back(root);
+
+	while (stack.size()) {
+		int32_t idx = stack.back();
+		stack.pop_back();
+		const Node &n = nodes[idx];
+
+		if (n.is_leaf()) {
+			if (MathUtils::is_bounds_visible(p_bounds[n.user_index], p_boxes, p_boxes_count, p_frustums, p_frustums_count)) {
+				r_mask[n.user_index / 32] |= 1u << (n.user_index % 32);
+				count++;
+			}
+			continue;
+		}
+
+		bool is_intersects_box = false;
+		bool is_inside_box = false;
+		for (size_t i = 0; i < p_boxes_count; i++) {
+			const AABBMinMax &box = p_boxes[i];
+			if (n.min.x < box.max.x && n.max.x > box.min.x &&
+					n.min.y < box.max.y && n.max.y > box.min.y &&
+					n.min.z < box.max.z && n.max.z > box.min.z) {
+				is_intersects_box = true;
+				if (n.min.x > box.min.x && n.max.x < box.max.x &&
+						n.min.y > box.min.y && n.max.y < box.max.y &&
+						n.min.z > box.min.z && n.max.z < box.max.z) {
+					is_inside_box = true;
+					break;
+				}
+			}
+		}
+
+		if (!is_intersects_box) {
+			continue;
+		}
+
+		bool is_intersects_frustum = p_frustums_count == 0;
+		bool is_inside_frustum = p_frustums_count == 0;
+		for (size_t f = 0; f < p_frustums_count && !is_inside_frustum; f++) {
+			bool is_outside = false;
+			bool is_intersects = false;
+			for (const Plane &p : p_frustums[f]) {
+				// The nearest and the farthest corners of the box along the normal
+				Vector3 near_corner = Vector3(p.normal.x >= 0 ? n.min.x : n.max.x, p.normal.y >= 0 ? n.min.y : n.max.y, p.normal.z >= 0 ? n.min.z : n.max.z);
+				Vector3 far_corner = Vector3(p.normal.x >= 0 ? n.max.x : n.min.x, p.normal.y >= 0 ? n.max.y : n.min.y, p.normal.z >= 0 ? n.max.z : n.min.z);
+
+				if (p.distance_to(near_corner) > 0) {
+					is_outside = true;
+					break;
+				}
+				if (p.distance_to(far_corner) > 0) {
+					is_intersects = true;
+				}
+			}
+
+			if (!is_outside) {
+				is_intersects_frustum = true;
+				is_inside_frustum = !is_intersects;
+			}
+		}
+
+		if (!is_intersects_frustum) {
+			continue;
+		}
+
+		if (is_inside_box && is_inside_frustum) {
+			add_subtree_to_mask(idx, r_mask, count);
+			continue;
+		}
+
+		stack.push_back(n.child1);
+		stack.push_back(n.child2);
+	}
+
+	return count;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "math_utils.h"
+
+#include <array>
+#include <vector>
+
+GODOT_WARNING_DISABLE()
+#include <godot_cpp/variant/builtin_types.hpp>
+GODOT_WARNING_RESTORE()
+using namespace godot;
+
+/// Dynamic AABB tree of indices of objects.
+/// Leaves are inserted and removed incrementally, and the tree is balanced by rotations.
+class AABBTree {
+	enum : int32_t {
+		NULL_NODE = -1,
+	};
+
+	struct Node {
+		Vector3 min;
+		Vector3 max;
+		int32_t parent_or_next = NULL_NODE;
+		int32_t child1 = NULL_NODE;
+		int32_t child2 = NULL_NODE;
+		// leaf = 0, free node = -1
+		int32_t height = -1;
+		uint32_t user_index = 0;
+
+		_FORCE_INLINE_ bool is_leaf() const {
+			return child1 == NULL_NODE;
+		}
+	};
+
+	std::vector<Node> nodes;
+	int32_t root = NULL_NODE;
+	int32_t free_list = NULL_NODE;
+	size_t leaves_count = 0;
+	std::vector<int32_t> stack;
+
+	int32_t alloc_node();
+	void free_node(int32_t p_node);
+	void insert_leaf(int32_t p_leaf);
+	void remove_leaf(int32_t p_leaf);
+	int32_t balance(int32_t p_node);
+	void refit(int32_t p_node);
+	void add_subtree_to_mask(int32_t p_node, uint32_t *r_mask, size_t &r_count);
+
+public:
+	/// Returns the leaf id
+	int32_t insert(const AABBMinMax &p_bounds, const uint32_t &p_user_index);
+	void remove(const int32_t &p_leaf);
+	void set_user_index(const int32_t &p_leaf, const uint32_t &p_user_index);
+	void clear();
+
+	_FORCE_INLINE_ size_t size() const {
+		return leaves_count;
+	}
+
+	/// Uses the same rules as MathUtils::cull_bounds_batch, but visits only the visible parts of the tree.
+	/// Subtrees that are completely visible are added without testing their leaves.
+	/// The bit of `user_index` is set in `r_mask` for each visible leaf. Returns the number of visible leaves.
+	size_t cull(const AABBMinMax *p_bounds, const AABBMinMax *p_boxes, const size_t &p_boxes_count, const std::array<Plane, 6> *p_frustums, const size_t &p_frustums_count, uint32_t *r_mask);
+};
@@ -1,5 +1,21 @@
 #include "math_utils.h"
 
+#include <cmath>
+#include <cstring>
+
+#ifndef REAL_T_IS_DOUBLE
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MATH_UTILS_AVX2
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define MATH_UTILS_SSE
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define MATH_UTILS_NEON
+#endif
+#endif
+
 const float MathUtils::Sqrt2 = Math::sqrt(2.f);
 const float MathUtils::CubeRadiusForSphere = 0.8660253882f; // "%.10f" % (Vector3.ONE * 0.5).length()
 const float MathUtils::CylinderRadiusForSphere = 0.7071067691f; // "%.10f" % (Vector3(1,1,0) * 0.5).length()
@@ -38,3 +54,359 @@ AABBMinMax::AABBMinMax(const SphereBounds &p_from) :
 	min = p_from.position - half;
 	max = p_from.position + half;
 }
+
+std::array<Plane, 6> MathUtils::get_projection_planes(const Projection &p_projection, const Transform3D &p_camera_xf) {
+	const Vector4 *m = p_projection.columns;
+	auto make_plane = [&p_camera_xf](const real_t &a, const real_t &b, const real_t &c, const real_t &d) {
+		Plane plane(a, b, c, d);
+		plane.normal = -plane.normal;
+		plane.normalize();
+		return p_camera_xf.xform(plane);
+	};
+
+	//  near, far, left, top, right, bottom
+	//  0,    1,   2,    3,   4,     5
+	return std::array<Plane, 6>({
+			make_plane(m[0].w + m[0].z, m[1].w + m[1].z, m[2].w + m[2].z, m[3].w + m[3].z),
+			make_plane(m[0].w - m[0].z, m[1].w - m[1].z, m[2].w - m[2].z, m[3].w - m[3].z),
+			make_plane(m[0].w + m[0].x, m[1].w + m[1].x, m[2].w + m[2].x, m[3].w + m[3].x),
+			make_plane(m[0].w - m[0].y, m[1].w - m[1].y, m[2].w - m[2].y, m[3].w - m[3].y),
+			make_plane(m[0].w - m[0].x, m[1].w - m[1].x, m[2].w - m[2].x, m[3].w - m[3].x),
+			make_plane(m[0].w + m[0].y, m[1].w + m[1].y, m[2].w + m[2].y, m[3].w + m[3].y),
+	});
+}
+
+bool MathUtils::is_bounds_visible(const AABBMinMax &p_bounds, const AABBMinMax *p_boxes, const size_t &p_boxes_count, const std::array<Plane, 6> *p_frustums, const size_t &p_frustums_count) {
+	for (size_t i = 0; i < p_boxes_count; i++) {
+		if (p_boxes[i].intersects(p_bounds)) {
+			goto frustum;
+		}
+	}
+	return false;
+frustum:
+	if (p_frustums_count) {
+		for (size_t i = 0; i < p_frustums_count; i++) {
+			if (MathUtils::is_bounds_partially_inside_convex_shape(p_bounds, p_frustums[i])) {
+				return true;
+			}
+		}
+		return false;
+	} else {
+		return true;
+	}
+}
+
+#if defined(MATH_UTILS_AVX2)
+#define CULL_BATCH_SIZE 8
+
+static _FORCE_INLINE_ uint32_t cull_bounds_lanes(const AABBMinMax *b, const AABBMinMax *p_boxes, const size_t &p_boxes_count, const std::array<Plane, 6> *p_frustums, const size_t &p_frustums_count) {
+	__m256 cx = _mm256_setr_ps(b[0].center.x, b[1].center.x, b[2].center.x, b[3].center.x, b[4].center.x, b[5].center.x, b[6].center.x, b[7].center.x);
+	__m256 cy = _mm256_setr_ps(b[0].center.y, b[1].center.y, b[2].center.y, b[3].center.y, b[4].center.y, b[5].center.y, b[6].center.y, b[7].center.y);
+	__m256 cz = _mm256_setr_ps(b[0].center.z, b[1].center.z, b[2].center.z, b[3].center.z, b[4].center.z, b[5].center.z, b[6].center.z, b[7].center.z);
+	__m256 r = _mm256_setr_ps(b[0].radius, b[1].radius, b[2].radius, b[3].radius, b[4].radius, b[5].radius, b[6].radius, b[7].radius);
+
+	__m256 box_vis = _mm256_setzero_ps();
+	if (p_boxes_count) {
+		__m256 min_x = _mm256_setr_ps(b[0].min.x, b[1].min.x, b[2].min.x, b[3].min.x, b[4].min.x, b[5].min.x, b[6].min.x, b[7].min.x);
+		__m256 min_y = _mm256_setr_ps(b[0].min.y, b[1].min.y, b[2].min.y, b[3].min.y, b[4].min.y, b[5].min.y, b[6].min.y, b[7].min.y);
+		__m256 min_z = _mm256_setr_ps(b[0].min.z, b[1].min.z, b[2].min.z, b[3].min.z, b[4].min.z, b[5].min.z, b[6].min.z, b[7].min.z);
+		__m256 max_x = _mm256_setr_ps(b[0].max.x, b[1].max.x, b[2].max.x, b[3].max.x, b[4].max.x, b[5].max.x, b[6].max.x, b[7].max.x);
+		__m256 max_y = _mm256_setr_ps(b[0].max.y, b[1].max.y, b[2].max.y, b[3].max.y, b[4].max.y, b[5].max.y, b[6].max.y, b[7].max.y);
+		__m256 max_z = _mm256_setr_ps(b[0].max.z, b[1].max.z, b[2].max.z, b[3].max.z, b[4].max.z, b[5].max.z, b[6].max.z, b[7].max.z);
+
+		for (size_t i = 0; i < p_boxes_count; i++) {
+			const AABBMinMax &box = p_boxes[i];
+			__m256 res = _mm256_and_ps(_mm256_cmp_ps(min_x, _mm256_set1_ps(box.max.x), _CMP_LT_OQ), _mm256_cmp_ps(max_x, _mm256_set1_ps(box.min.x), _CMP_GT_OQ));
+			res = _mm256_and_ps(res, _mm256_and_ps(_mm256_cmp_ps(min_y, _mm256_set1_ps(box.max.y), _CMP_LT_OQ), _mm256_cmp_ps(max_y, _mm256_set1_ps(box.min.y), _CMP_GT_OQ)));
+			res = _mm256_and_ps(res, _mm256_and_ps(_mm256_cmp_ps(min_z, _mm256_set1_ps(box.max.z), _CMP_LT_OQ), _mm256_cmp_ps(max_z, _mm256_set1_ps(box.min.z), _CMP_GT_OQ)));
+			box_vis = _mm256_or_ps(box_vis, res);
+		}
+	}
+
+	uint32_t mask = (uint32_t)_mm256_movemask_ps(box_vis);
+	if (!mask || !p_frustums_count) {
+		return mask;
+	}
+
+	__m256 frustum_vis = _mm256_setzero_ps();
+	for (size_t f = 0; f < p_frustums_count; f++) {
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (const Plane &p : p_frustums[f]) {
+			// distance_to: normal.dot(center) - d
+			__m256 dist = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, _mm256_set1_ps(p.normal.x)), _mm256_mul_ps(cy, _mm256_set1_ps(p.normal.y))), _mm256_mul_ps(cz, _mm256_set1_ps(p.normal.z))), _mm256_set1_ps(p.d));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(r, dist, _CMP_NLT_UQ));
+		}
+		frustum_vis = _mm256_or_ps(frustum_vis, inside);
+	}
+	return mask & (uint32_t)_mm256_movemask_ps(frustum_vis);
+}
+
+#elif defined(MATH_UTILS_SSE)
+#define CULL_BATCH_SIZE 4
+
+static _FORCE_INLINE_ uint32_t cull_bounds_lanes(const AABBMinMax *b, const AABBMinMax *p_boxes, const size_t &p_boxes_count, const std::array<Plane, 6> *p_frustums, const size_t &p_frustums_count) {
+	// center and radius are stored as 4 contiguous floats
+	__m128 cx = _mm_loadu_ps(&b[0].center.x);
+	__m128 cy = _mm_loadu_ps(&b[1].center.x);
+	__m128 cz = _mm_loadu_ps(&b[2].center.x);
+	__m128 r = _mm_loadu_ps(&b[3].center.x);
+	_MM_TRANSPOSE4_PS(cx, cy, cz, r);
+
+	__m128 box_vis = _mm_setzero_ps();
+	if (p_boxes_count) {
+		__m128 min_x = _mm_setr_ps(b[0].min.x, b[1].min.x, b[2].min.x, b[3].min.x);
+		__m128 min_y = _mm_setr_ps(b[0].min.y, b[1].min.y, b[2].min.y, b[3].min.y);
+		__m128 min_z = _mm_setr_ps(b[0].min.z, b[1].min.z, b[2].min.z, b[3].min.z);
+		__m128 max_x = _mm_setr_ps(b[0].max.x, b[1].max.x, b[2].max.x, b[3].max.x);
+		__m128 max_y = _mm_setr_ps(b[0].max.y, b[1].max.y, b[2].max.y, b[3].max.y);
+		__m128 max_z = _mm_setr_ps(b[0].max.z, b[1].max.z, b[2].max.z, b[3].max.z);
+
+		for (size_t i = 0; i < p_boxes_count; i++) {
+			const AABBMinMax &box = p_boxes[i];
+			__m128 res = _mm_and_ps(_mm_cmplt_ps(min_x, _mm_set1_ps(box.max.x)), _mm_cmpgt_ps(max_x, _mm_set1_ps(box.min.x)));
+			res = _mm_and_ps(res, _mm_and_ps(_mm_cmplt_ps(min_y, _mm_set1_ps(box.max.y)), _mm_cmpgt_ps(max_y, _mm_set1_ps(box.min.y))));
+			res = _mm_and_ps(res, _mm_and_ps(_mm_cmplt_ps(min_z, _mm_set1_ps(box.max.z)), _mm_cmpgt_ps(max_z, _mm_set1_ps(box.min.z))));
+			box_vis = _mm_or_ps(box_vis, res);
+		}
+	}
+
+	uint32_t mask = (uint32_t)_mm_movemask_ps(box_vis);
+	if (!mask || !p_frustums_count) {
+		return mask;
+	}
+
+	__m128 frustum_vis = _mm_setzero_ps();
+	for (size_t f = 0; f < p_frustums_count; f++) {
+		__m128 inside = _mm_cmpeq_ps(r, r);
+		for (const Plane &p : p_frustums[f]) {
+			// distance_to: normal.dot(center) - d
+			__m128 dist = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(p.normal.x)), _mm_mul_ps(cy, _mm_set1_ps(p.normal.y))), _mm_mul_ps(cz, _mm_set1_ps(p.normal.z))), _mm_set1_ps(p.d));
+			inside = _mm_and_ps(inside, _mm_cmpnlt_ps(r, dist));
+		}
+		frustum_vis = _mm_or_ps(frustum_vis, inside);
+	}
+	return mask & (uint32_t)_mm_movemask_ps(frustum_vis);
+}
+
+#elif defined(MATH_UTILS_NEON)
+#define CULL_BATCH_SIZE 4
+
+static _FORCE_INLINE_ uint32_t neon_movemask(const uint32x4_t &p_value) {
+	static const uint32_t bits[4] = { 1, 2, 4, 8 };
+	return vaddvq_u32(vandq_u32(p_value, vld1q_u32(bits)));
+}
+
+static _FORCE_INLINE_ uint32_t cull_bounds_lanes(const AABBMinMax *b, const AABBMinMax *p_boxes, const size_t &p_boxes_count, const std::array<Plane, 6> *p_frustums, const size_t &p_frustums_count) {
+	// center and radius are stored as 4 contiguous floats
+	float32x4x2_t t01 = vtrnq_f32(vld1q_f32(&b[0].center.x), vld1q_f32(&b[1].center.x));
+	float32x4x2_t t23 = vtrnq_f32(vld1q_f32(&b[2].center.x), vld1q_f32(&b[3].center.x));
+	float32x4_t cx = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+	float32x4_t cy = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+	float32x4_t cz = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+	float32x4_t r = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+
+	uint32x4_t box_vis = vdupq_n_u32(0);
+	if (p_boxes_count) {
+		const float min_x_a[4] = { b[0].min.x, b[1].min.x, b[2].min.x, b[3].min.x };
+		const float min_y_a[4] = { b[0].min.y, b[1].min.y, b[2].min.y, b[3].min.y };
+		const float min_z_a[4] = { b[0].min.z, b[1].min.z, b[2].min.z, b[3].min.z };
+		const float max_x_a[4] = { b[0].max.x, b[1].max.x, b[2].max.x, b[3].max.x };
+		const float max_y_a[4] = { b[0].max.y, b[1].max.y, b[2].max.y, b[3].max.y };
+		const float max_z_a[4] = { b[0].max.z, b[1].max.z, b[2].max.z, b[3].max.z };
+		float32x4_t min_x = vld1q_f32(min_x_a), min_y = vld1q_f32(min_y_a), min_z = vld1q_f32(min_z_a);
+		float32x4_t max_x = vld1q_f32(max_x_a), max_y = vld1q_f32(max_y_a), max_z = vld1q_f32(max_z_a);
+
+		for (size_t i = 0; i < p_boxes_count; i++) {
+			const AABBMinMax &box = p_boxes[i];
+			uint32x4_t res = vandq_u32(vcltq_f32(min_x, vdupq_n_f32(box.max.x)), vcgtq_f32(max_x, vdupq_n_f32(box.min.x)));
+			res = vandq_u32(res, vandq_u32(vcltq_f32(min_y, vdupq_n_f32(box.max.y)), vcgtq_f32(max_y, vdupq_n_f32(box.min.y))));
+			res = vandq_u32(res, vandq_u32(vcltq_f32(min_z, vdupq_n_f32(box.max.z)), vcgtq_f32(max_z, vdupq_n_f32(box.min.z))));
+			box_vis = vorrq_u32(box_vis, res);
+		}
+	}
+
+	uint32_t mask = neon_movemask(box_vis);
+	if (!mask || !p_frustums_count) {
+		return mask;
+	}
+
+	uint32x4_t frustum_vis = vdupq_n_u32(0);
+	for (size_t f = 0; f < p_frustums_count; f++) {
+		uint32x4_t inside = vdupq_n_u32(0xFFFFFFFF);
+		for (const Plane &p : p_frustums[f]) {
+			// distance_to: normal.dot(center) - d
+			float32x4_t dist = vsubq_f32(vmlaq_n_f32(vmlaq_n_f32(vmulq_n_f32(cx, p.normal.x), cy, p.normal.y), cz, p.normal.z), vdupq_n_f32(p.d));
+			inside = vandq_u32(inside, vmvnq_u32(vcltq_f32(r, dist)));
+		}
+		frustum_vis = vorrq_u32(frustum_vis, inside);
+	}
+	return mask & neon_movemask(frustum_vis);
+}
+
+#endif
+
+void MathUtils::cull_bounds_batch(const AABBMinMax *p_bounds, const size_t &p_count, const AABBMinMax *p_boxes, const size_t &p_boxes_count, const std::array<Plane, 6> *p_frustums, const size_t &p_frustums_count, uint32_t *r_mask) {
+	memset(r_mask, 0, ((p_count + 31) / 32) * sizeof(uint32_t));
+
+	size_t i = 0;
+#ifdef CULL_BATCH_SIZE
+	// 32 is a multiple of the batch size, so the batch never crosses the mask value.
+	for (; i + CULL_BATCH_SIZE <= p_count; i += CULL_BATCH_SIZE) {
+		r_mask[i / 32] |= cull_bounds_lanes(p_bounds + i, p_boxes, p_boxes_count, p_frustums, p_frustums_count) << (i % 32);
+	}
+#undef CULL_BATCH_SIZE
+#endif
+
+	for (; i < p_count; i++) {
+		if (is_bounds_visible(p_bounds[i], p_boxes, p_boxes_count, p_frustums, p_frustums_count)) {
+			r_mask[i / 32] |= 1u << (i % 32);
+		}
+	}
+}
+
+// Orthonormal basis of a segment without `Basis::looking_at`.
+// -Z points from A to B as in `looking_at`, and X and Y are built with the branchless method from
+// "Building an Orthonormal Basis, Revisited" (Duff et al. 2017). A zero-length segment gets a zero Z axis.
+static _FORCE_INLINE_ void get_segment_basis(const Vector3 &p_a, const Vector3 &p_b, Vector3 &r_x, Vector3 &r_y, Vector3 &r_z, real_t &r_len) {
+	Vector3 d = p_b - p_a;
+	r_len = d.length();
+	r_z = d * (r_len > 0 ? -1 / r_len : 0);
+
+	real_t sign = std::copysign((real_t)1, r_z.z);
+	real_t a = -1 / (sign + r_z.z);
+	real_t b = r_z.x * r_z.y * a;
+	r_x = Vector3(1 + sign * r_z.x * r_z.x * a, sign * b, -sign * r_z.x);
+	r_y = Vector3(b, sign + r_z.y * r_z.y * a, -r_z.y);
+}
+
+#if defined(MATH_UTILS_AVX2) || defined(MATH_UTILS_SSE)
+#define SEGMENT_BATCH_SIZE 4
+
+// The same as `get_segment_basis`, but for 4 segments. The results are stored as [x.xyz, y.xyz, z.xyz, len][lane].
+static _FORCE_INLINE_ void get_segment_basis_lanes(const Vector3 *l, float r_out[10][SEGMENT_BATCH_SIZE]) {
+	__m128 dx = _mm_sub_ps(_mm_setr_ps(l[1].x, l[3].x, l[5].x, l[7].x), _mm_setr_ps(l[0].x, l[2].x, l[4].x, l[6].x));
+	__m128 dy = _mm_sub_ps(_mm_setr_ps(l[1].y, l[3].y, l[5].y, l[7].y), _mm_setr_ps(l[0].y, l[2].y, l[4].y, l[6].y));
+	__m128 dz = _mm_sub_ps(_mm_setr_ps(l[1].z, l[3].z, l[5].z, l[7].z), _mm_setr_ps(l[0].z, l[2].z, l[4].z, l[6].z));
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1);
+	const __m128 minus_one = _mm_set1_ps(-1);
+	const __m128 sign_mask = _mm_set1_ps(-0.f);
+
+	__m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+	// -1 / 0 is masked out
+	__m128 inv = _mm_and_ps(_mm_cmpgt_ps(len, zero), _mm_div_ps(minus_one, len));
+	__m128 zx = _mm_mul_ps(dx, inv);
+	__m128 zy = _mm_mul_ps(dy, inv);
+	__m128 zz = _mm_mul_ps(dz, inv);
+
+	__m128 sign = _mm_or_ps(_mm_and_ps(zz, sign_mask), one);
+	__m128 a = _mm_div_ps(minus_one, _mm_add_ps(sign, zz));
+	__m128 b = _mm_mul_ps(_mm_mul_ps(zx, zy), a);
+
+	_mm_storeu_ps(r_out[0], _mm_add_ps(one, _mm_mul_ps(_mm_mul_ps(sign, _mm_mul_ps(zx, zx)), a)));
+	_mm_storeu_ps(r_out[1], _mm_mul_ps(sign, b));
+	_mm_storeu_ps(r_out[2], _mm_xor_ps(_mm_mul_ps(sign, zx), sign_mask));
+	_mm_storeu_ps(r_out[3], b);
+	_mm_storeu_ps(r_out[4], _mm_add_ps(sign, _mm_mul_ps(_mm_mul_ps(zy, zy), a)));
+	_mm_storeu_ps(r_out[5], _mm_xor_ps(zy, sign_mask));
+	_mm_storeu_ps(r_out[6], zx);
+	_mm_storeu_ps(r_out[7], zy);
+	_mm_storeu_ps(r_out[8], zz);
+	_mm_storeu_ps(r_out[9], len);
+}
+
+#elif defined(MATH_UTILS_NEON)
+#define SEGMENT_BATCH_SIZE 4
+
+// The same as `get_segment_basis`, but for 4 segments. The results are stored as [x.xyz, y.xyz, z.xyz, len][lane].
+static _FORCE_INLINE_ void get_segment_basis_lanes(const Vector3 *l, float r_out[10][SEGMENT_BATCH_SIZE]) {
+	// Interleaved A and B of 4 segments
+	float32x4x3_t ab0 = vld3q_f32(&l[0].x);
+	float32x4x3_t ab1 = vld3q_f32(&l[4].x);
+	float32x4x2_t x = vuzpq_f32(ab0.val[0], ab1.val[0]);
+	float32x4x2_t y = vuzpq_f32(ab0.val[1], ab1.val[1]);
+	float32x4x2_t z = vuzpq_f32(ab0.val[2], ab1.val[2]);
+	float32x4_t dx = vsubq_f32(x.val[1], x.val[0]);
+	float32x4_t dy = vsubq_f32(y.val[1], y.val[0]);
+	float32x4_t dz = vsubq_f32(z.val[1], z.val[0]);
+
+	const float32x4_t one = vdupq_n_f32(1);
+	const float32x4_t minus_one = vdupq_n_f32(-1);
+	const uint32x4_t sign_mask = vdupq_n_u32(0x80000000);
+
+	float32x4_t len = vsqrtq_f32(vmlaq_f32(vmlaq_f32(vmulq_f32(dx, dx), dy, dy), dz, dz));
+	// -1 / 0 is masked out
+	float32x4_t inv = vreinterpretq_f32_u32(vandq_u32(vcgtq_f32(len, vdupq_n_f32(0)), vreinterpretq_u32_f32(vdivq_f32(minus_one, len))));
+	float32x4_t zx = vmulq_f32(dx, inv);
+	float32x4_t zy = vmulq_f32(dy, inv);
+	float32x4_t zz = vmulq_f32(dz, inv);
+
+	float32x4_t sign = vbslq_f32(sign_mask, zz, one);
+	float32x4_t a = vdivq_f32(minus_one, vaddq_f32(sign, zz));
+	float32x4_t b = vmulq_f32(vmulq_f32(zx, zy), a);
+
+	vst1q_f32(r_out[0], vaddq_f32(one, vmulq_f32(vmulq_f32(sign, vmulq_f32(zx, zx)), a)));
+	vst1q_f32(r_out[1], vmulq_f32(sign, b));
+	vst1q_f32(r_out[2], vnegq_f32(vmulq_f32(sign, zx)));
+	vst1q_f32(r_out[3], b);
+	vst1q_f32(r_out[4], vaddq_f32(sign, vmulq_f32(vmulq_f32(zy, zy), a)));
+	vst1q_f32(r_out[5], vnegq_f32(zy));
+	vst1q_f32(r_out[6], zx);
+	vst1q_f32(r_out[7], zy);
+	vst1q_f32(r_out[8], zz);
+	vst1q_f32(r_out[9], len);
+}
+
+#endif
+
+// Calls `p_func(i, x, y, z, len)` with the basis of each segment
+template <class TFunc>
+static _FORCE_INLINE_ void for_each_segment_basis(const Vector3 *p_lines, const size_t &p_count, const TFunc &p_func) {
+	size_t i = 0;
+#ifdef SEGMENT_BATCH_SIZE
+	float lanes[10][SEGMENT_BATCH_SIZE];
+	for (; i + SEGMENT_BATCH_SIZE <= p_count; i += SEGMENT_BATCH_SIZE) {
+		get_segment_basis_lanes(p_lines + i * 2, lanes);
+		for (size_t j = 0; j < SEGMENT_BATCH_SIZE; j++) {
+			p_func(i + j,
+					Vector3(lanes[0][j], lanes[1][j], lanes[2][j]),
+					Vector3(lanes[3][j], lanes[4][j], lanes[5][j]),
+					Vector3(lanes[6][j], lanes[7][j], lanes[8][j]),
+					(real_t)lanes[9][j]);
+		}
+	}
+#undef SEGMENT_BATCH_SIZE
+#endif
+
+	for (; i < p_count; i++) {
+		Vector3 x, y, z;
+		real_t len;
+		get_segment_basis(p_lines[i * 2], p_lines[i * 2 + 1], x, y, z, len);
+		p_func(i, x, y, z, len);
+	}
+}
+
+static _FORCE_INLINE_ Transform3D make_transform(const Vector3 &p_x, const Vector3 &p_y, const Vector3 &p_z, const Vector3 &p_origin) {
+	return Transform3D(p_x.x, p_y.x, p_z.x, p_x.y, p_y.y, p_z.y, p_x.z, p_y.z, p_z.z, p_origin.x, p_origin.y, p_origin.z);
+}
+
+void MathUtils::get_line_segment_endpoint_transforms(const Vector3 *p_lines, const size_t &p_count, Transform3D *r_transforms, SphereBounds *r_bounds) {
+	for (size_t i = 0; i < p_count; i++) {
+		const Vector3 &a = p_lines[i * 2];
+		const Vector3 &b = p_lines[i * 2 + 1];
+		const Vector3 d = a - b;
+		r_transforms[i] = Transform3D(0, 0, d.x, 0, 0, d.y, 0, 0, d.z, a.x, a.y, a.z);
+		r_bounds[i] = SphereBounds((a + b) * 0.5f, d.length() * 0.5f);
+	}
+}
+
+void MathUtils::get_cylinder_ab_transforms(const Vector3 *p_lines, const size_t &p_count, const float *p_radii, const size_t &p_radii_step, Transform3D *r_transforms, SphereBounds *r_bounds) {
+	for_each_segment_basis(p_lines, p_count, [&](const size_t &i, const Vector3 &x, const Vector3 &y, const Vector3 &z, const real_t &len) {
+		const real_t radius = p_radii[i * p_radii_step];
+		const Vector3 center = p_lines[i * 2] - z * (len * 0.5f);
+		r_transforms[i] = make_transform(x * radius, y * radius, z * len, center);
+		// The same as `get_max_basis_length(basis) * CylinderRadiusForSphere`
+		r_bounds[i] = SphereBounds(center, Math::max(Math::abs(radius), len) * CylinderRadiusForSphere);
+	});
+}
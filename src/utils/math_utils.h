@@ -3,7 +3,6 @@
 #include "compiler.h"
 
 #include <array>
-#include <functional>
 
 GODOT_WARNING_DISABLE()
 #include <godot_cpp/variant/builtin_types.hpp>
@@ -11,6 +10,7 @@ GODOT_WARNING_RESTORE()
 using namespace godot;
 
 struct AABBMinMax;
+struct SphereBounds;
 
 class MathUtils {
 
@@ -28,8 +28,27 @@ public:
 	_FORCE_INLINE_ static real_t get_max_basis_length(const Basis &p_b);
 	_FORCE_INLINE_ static AABB calculate_vertex_bounds(const Vector3 *p_lines, size_t p_count);
 
-	_FORCE_INLINE_ static std::array<Vector3, 8> get_frustum_cube(const std::array<Plane, 6> p_frustum);
+	_FORCE_INLINE_ static std::array<Vector3, 8> get_frustum_cube(const std::array<Plane, 6> &p_frustum);
 	_FORCE_INLINE_ static void scale_frustum_far_plane_distance(std::array<Plane, 6> &p_frustum, const Transform3D &p_camera_xf, const real_t &p_scale);
+	/// The same planes as in `Camera3D::get_frustum`, but without the Variant Array.
+	/// The order is: near, far, left, top, right, bottom.
+	static std::array<Plane, 6> get_projection_planes(const Projection &p_projection, const Transform3D &p_camera_xf);
+
+	/// Scalar version of `cull_bounds_batch` for a single element.
+	static bool is_bounds_visible(const AABBMinMax &p_bounds, const AABBMinMax *p_boxes, const size_t &p_boxes_count, const std::array<Plane, 6> *p_frustums, const size_t &p_frustums_count);
+	/// Culls the array of bounds against the AABB of frustums and against the frustums themselves.
+	/// The bounds are visible if they intersect any of the boxes and, if there are frustums, the sphere is inside any of them.
+	/// Bit `i % 32` of `r_mask[i / 32]` is set for each visible element. `r_mask` must have space for `(p_count + 31) / 32` values.
+	static void cull_bounds_batch(const AABBMinMax *p_bounds, const size_t &p_count, const AABBMinMax *p_boxes, const size_t &p_boxes_count, const std::array<Plane, 6> *p_frustums, const size_t &p_frustums_count, uint32_t *r_mask);
+
+	/// Packs pairs of points in `p_lines` into the transforms of the unit line mesh.
+	/// The origin is A and the Z axis is `A - B`, the other axes are zero.
+	/// The orientation of volumetric lines is built from this axis in the shader.
+	static void get_line_segment_endpoint_transforms(const Vector3 *p_lines, const size_t &p_count, Transform3D *r_transforms, SphereBounds *r_bounds);
+	/// Builds the transforms of the cylinders from pairs of points in `p_lines` in one pass.
+	/// -Z of each basis points from A to B as in `Basis::looking_at`, X and Y are scaled by the radius, Z by the length and the origin is the center of the segment.
+	/// The radius of segment `i` is `p_radii[i * p_radii_step]`.
+	static void get_cylinder_ab_transforms(const Vector3 *p_lines, const size_t &p_count, const float *p_radii, const size_t &p_radii_step, Transform3D *r_transforms, SphereBounds *r_bounds);
 };
 
 struct SphereBounds {
@@ -156,8 +175,8 @@ AABB MathUtils::calculate_vertex_bounds(const Vector3 *p_lines, size_t p_count)
 	}
 }
 
-std::array<Vector3, 8> MathUtils::get_frustum_cube(const std::array<Plane, 6> p_frustum) {
-	std::function<Vector3(const Plane &, const Plane &, const Plane &)> intersect_planes = [&](const Plane &a, const Plane &b, const Plane &c) {
+std::array<Vector3, 8> MathUtils::get_frustum_cube(const std::array<Plane, 6> &p_frustum) {
+	auto intersect_planes = [](const Plane &a, const Plane &b, const Plane &c) {
 		Vector3 intersec_result;
 		a.intersect_3(b, c, &intersec_result);
 		return intersec_result;